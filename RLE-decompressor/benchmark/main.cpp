@@ -0,0 +1,147 @@
+#include "../compressor.h"
+#include "../decompressor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//Данные вперемешку из повторов и случайных байтов; repeat_share - доля байтов в повторах.
+//Длины повторов и случайных кусков - до 300 байт, так что встречаются и блоки короче максимального, и длиннее
+std::string GenerateData(size_t size, double repeat_share, uint32_t seed) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::string data;
+    data.reserve(size + 300);
+    while (data.size() < size) {
+        const size_t length = 1 + generator() % 300;
+        if (uniform(generator) < repeat_share) {
+            data.append(length, static_cast<char>(generator()));
+        } else {
+            for (size_t i = 0; i < length; ++i) {
+                data += static_cast<char>(generator());
+            }
+        }
+    }
+    data.resize(size);
+    return data;
+}
+
+//encoded_size читается после operation, так что кодирование может само его задать.
+//Печатает строку CSV: benchmark,repeat_share,raw_bytes,encoded_bytes,seconds,gb_per_sec; скорость - по несжатым байтам
+template <typename Operation>
+void Run(std::ostream& out, const std::string& name, double repeat_share, size_t raw_size, const size_t& encoded_size, Operation operation) {
+    const auto start = std::chrono::steady_clock::now();
+    operation();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    out << name << ',' << repeat_share << ',' << raw_size << ',' << encoded_size << ',' << seconds << ',' << raw_size / seconds / 1e9 << std::endl;
+}
+
+//замеры неверной распаковки ничего не значат, поэтому при расхождении с исходными данными программа завершается с ошибкой
+void CheckRoundTrip(bool is_equal, const std::string& name) {
+    if (!is_equal) {
+        std::cerr << name << " round trip mismatch" << std::endl;
+        std::exit(1);
+    }
+}
+
+std::string ReadFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+void RunBenchmarks(std::ostream& out, size_t size, double repeat_share, uint32_t seed) {
+    using namespace std::string_literals;
+    
+    const std::string data = GenerateData(size, repeat_share, seed);
+    std::vector<char> encoded(GetMaxEncodedRLESize(data.size()));
+    size_t encoded_size = 0;
+    Run(out, "EncodeBuffer"s, repeat_share, data.size(), encoded_size, [&]() {
+        encoded_size = EncodeRLEBuffer(data, encoded.data());
+    });
+    encoded.resize(encoded_size);
+    const std::string_view encoded_view(encoded.data(), encoded.size());
+    
+    std::vector<char> decoded(data.size());
+    Run(out, "DecodeBuffer"s, repeat_share, data.size(), encoded_size, [&]() {
+        RleDecoder().Decode(encoded_view, decoded.data(), decoded.size());
+    });
+    //выход кусками по 64 КиБ, как при записи в поток
+    Run(out, "DecodeStream"s, repeat_share, data.size(), encoded_size, [&]() {
+        const size_t CHUNK_SIZE = 64 * 1024;
+        RleDecoder decoder;
+        std::string_view input = encoded_view;
+        for (size_t pos = 0; pos < decoded.size(); ) {
+            const RleDecoder::Result result = decoder.Decode(input, decoded.data() + pos, std::min(CHUNK_SIZE, decoded.size() - pos));
+            input.remove_prefix(result.consumed);
+            pos += result.produced;
+        }
+    });
+    CheckRoundTrip(decoded == std::vector<char>(data.begin(), data.end()), "DecodeStream"s);
+    
+    const std::string raw_path = "rle_benchmark_raw.bin"s;
+    const std::string encoded_path = "rle_benchmark_encoded.bin"s;
+    const std::string decoded_path = "rle_benchmark_decoded.bin"s;
+    {
+        std::ofstream raw_file(raw_path, std::ios::binary);
+        raw_file.write(data.data(), data.size());
+    }
+    Run(out, "EncodeFile"s, repeat_share, data.size(), encoded_size, [&]() {
+        EncodeRLE(raw_path, encoded_path);
+    });
+    bool is_decoded = false;
+    Run(out, "DecodeFile"s, repeat_share, data.size(), encoded_size, [&]() {
+        is_decoded = DecodeRLE(encoded_path, decoded_path);
+    });
+    CheckRoundTrip(is_decoded && ReadFile(decoded_path) == data, "DecodeFile"s);
+    
+    //кадрированный архив: распаковка всеми ядрами и чтение случайных диапазонов по RANGE_SIZE байт
+    const std::string framed_path = "rle_benchmark_framed.bin"s;
+    Run(out, "EncodeFramedFile"s, repeat_share, data.size(), encoded_size, [&]() {
+        EncodeRLEFramed(raw_path, framed_path);
+    });
+    Run(out, "DecodeFramedFile"s, repeat_share, data.size(), encoded_size, [&]() {
+        is_decoded = DecodeRLE(framed_path, decoded_path);
+    });
+    CheckRoundTrip(is_decoded && ReadFile(decoded_path) == data, "DecodeFramedFile"s);
+    const size_t RANGE_SIZE = 4096;
+    const size_t RANGE_COUNT = 1000;
+    //диапазоны сверяются с данными после замера, поэтому их начала запоминаются
+    std::vector<uint64_t> range_offsets;
+    std::vector<char> ranges(RANGE_SIZE * RANGE_COUNT);
+    Run(out, "ReadFramedRange"s, repeat_share, RANGE_SIZE * RANGE_COUNT, encoded_size, [&]() {
+        const RleFramedReader reader(framed_path);
+        std::mt19937_64 generator(seed);
+        for (size_t i = 0; i < RANGE_COUNT; ++i) {
+            range_offsets.push_back(generator() % data.size());
+            reader.Read(range_offsets.back(), ranges.data() + i * RANGE_SIZE, RANGE_SIZE);
+        }
+    });
+    for (size_t i = 0; i < RANGE_COUNT; ++i) {
+        const std::string_view expected = std::string_view(data).substr(range_offsets[i], RANGE_SIZE);
+        CheckRoundTrip(std::string_view(ranges.data() + i * RANGE_SIZE, expected.size()) == expected, "ReadFramedRange"s);
+    }
+    std::remove(framed_path.c_str());
+    std::remove(raw_path.c_str());
+    std::remove(encoded_path.c_str());
+    std::remove(decoded_path.c_str());
+}
+
+//использование: benchmark [size_mb [seed]]; файлы создаются в текущем каталоге
+int main(int argc, char* argv[]) {
+    const size_t size = (argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 256) << 20;
+    const uint32_t seed = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 42;
+    
+    std::cout << "benchmark,repeat_share,raw_bytes,encoded_bytes,seconds,gb_per_sec" << std::endl;
+    for (const double repeat_share : {0.1, 0.5, 0.9}) {
+        RunBenchmarks(std::cout, size, repeat_share, seed);
+    }
+    return 0;
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "decompressor.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//повтор короче не выгоднее простого блока: два одинаковых байта в простом блоке занимают столько же, сколько блок повтора
+const size_t RLE_MIN_REPEAT_SIZE = 3;
+
+//в худшем случае, без единого повтора, к каждым RLE_MAX_BLOCK_SIZE байтам добавляется заголовок
+inline size_t GetMaxEncodedRLESize(size_t size) {
+    return size + (size + RLE_MAX_BLOCK_SIZE - 1) / RLE_MAX_BLOCK_SIZE;
+}
+
+//Поиск повторов и их концов идёт словами по 8 байт: в слове (x ^ y) | (x ^ z), где y и z - те же байты со сдвигом на один и два,
+//нулевой байт означает три одинаковых байта подряд. Найдя слово с совпадением, точное место ищем побайтно - так не важен порядок байт
+inline uint64_t LoadRLEWord(const char* data) {
+    uint64_t word;
+    std::memcpy(&word, data, sizeof(word));
+    return word;
+}
+
+inline bool HasZeroByte(uint64_t word) {
+    return ((word - 0x0101010101010101ull) & ~word & 0x8080808080808080ull) != 0;
+}
+
+//первая позиция, с которой начинаются RLE_MIN_REPEAT_SIZE одинаковых байтов, или end
+inline const char* FindRLERepeat(const char* begin, const char* end) {
+    const char* it = begin;
+    while (end - it >= static_cast<ptrdiff_t>(sizeof(uint64_t) + 2)) {
+        const uint64_t x = LoadRLEWord(it);
+        if (HasZeroByte((x ^ LoadRLEWord(it + 1)) | (x ^ LoadRLEWord(it + 2)))) {
+            break;
+        }
+        it += sizeof(uint64_t);
+    }
+    for (; end - it >= static_cast<ptrdiff_t>(RLE_MIN_REPEAT_SIZE); ++it) {
+        if (it[0] == it[1] && it[0] == it[2]) {
+            return it;
+        }
+    }
+    return end;
+}
+
+//длина повтора байта *begin, не больше limit
+inline size_t GetRLERunSize(const char* begin, size_t limit) {
+    const uint64_t pattern = 0x0101010101010101ull * static_cast<unsigned char>(*begin);
+    size_t run = 0;
+    while (limit - run >= sizeof(uint64_t) && LoadRLEWord(begin + run) == pattern) {
+        run += sizeof(uint64_t);
+    }
+    while (run < limit && begin[run] == *begin) {
+        ++run;
+    }
+    return run;
+}
+
+//Кодирует input в формате DecodeRLE. В output должно помещаться GetMaxEncodedRLESize(input.size()) байт; возвращает длину кода.
+//Блоки не выходят за границы input, поэтому длинные данные можно кодировать кусками и склеивать коды
+inline size_t EncodeRLEBuffer(std::string_view input, char* output) {
+    const char* in = input.data();
+    const char* const in_end = in + input.size();
+    const char* literal = in; //начало ещё не записанных байтов без повторов
+    char* out = output;
+    
+    auto flush_literal = [&](const char* end) {
+        while (literal != end) {
+            const size_t size = std::min<size_t>(end - literal, RLE_MAX_BLOCK_SIZE);
+            *out++ = static_cast<char>((size - 1) << 1);
+            std::memcpy(out, literal, size);
+            out += size;
+            literal += size;
+        }
+    };
+    
+    while ((in = FindRLERepeat(in, in_end)) != in_end) {
+        const size_t run = GetRLERunSize(in, std::min<size_t>(in_end - in, RLE_MAX_BLOCK_SIZE));
+        flush_literal(in);
+        *out++ = static_cast<char>(((run - 1) << 1) | 1);
+        *out++ = in[0];
+        in += run;
+        literal = in;
+    }
+    flush_literal(in_end);
+    return out - output;
+}
+
+//вход читается и кодируется кусками по RLE_INPUT_CHUNK_SIZE
+inline bool EncodeRLE(const std::string& src_name, const std::string& dst_name) {
+    using namespace std;
+    
+    ifstream fin(src_name, ios::in | ios::binary);
+    if (!fin) {
+        return false;
+    }
+    
+    ofstream fout(dst_name, ios::out | ios::binary);
+    vector<char> chunk(RLE_INPUT_CHUNK_SIZE);
+    vector<char> buffer(GetMaxEncodedRLESize(chunk.size()));
+    while (fin.read(chunk.data(), chunk.size()) || fin.gcount() > 0) {
+        const size_t size = EncodeRLEBuffer({chunk.data(), static_cast<size_t>(fin.gcount())}, buffer.data());
+        fout.write(buffer.data(), size);
+    }
+    
+    return true;
+}
+
+//Кадрированный архив для параллельной распаковки и чтения диапазонов через RleFramedReader: куски по chunk_size байт
+//кодируются независимо, индекс и подпись дописываются в конец
+inline bool EncodeRLEFramed(const std::string& src_name, const std::string& dst_name, size_t chunk_size = RLE_FRAME_CHUNK_SIZE) {
+    using namespace std;
+    
+    ifstream fin(src_name, ios::in | ios::binary);
+    if (!fin || chunk_size == 0) {
+        return false;
+    }
+    
+    ofstream fout(dst_name, ios::out | ios::binary);
+    vector<char> chunk(chunk_size);
+    vector<char> buffer(GetMaxEncodedRLESize(chunk.size()));
+    vector<RleChunkIndexEntry> index;
+    uint64_t compressed_size = 0;
+    uint64_t decompressed_size = 0;
+    while (fin.read(chunk.data(), chunk.size()) || fin.gcount() > 0) {
+        const size_t size = fin.gcount();
+        index.push_back({compressed_size, decompressed_size, ComputeRLEChecksum(chunk.data(), size)});
+        const size_t encoded_size = EncodeRLEBuffer({chunk.data(), size}, buffer.data());
+        fout.write(buffer.data(), encoded_size);
+        compressed_size += encoded_size;
+        decompressed_size += size;
+    }
+    
+    const size_t index_size = index.size() * sizeof(RleChunkIndexEntry);
+    RleFrameFooter footer{index.size(), decompressed_size, ComputeRLEChecksum(reinterpret_cast<const char*>(index.data()), index_size), {}};
+    std::memcpy(footer.magic, RLE_FRAME_MAGIC, sizeof(footer.magic));
+    fout.write(reinterpret_cast<const char*>(index.data()), index_size);
+    fout.write(reinterpret_cast<const char*>(&footer), sizeof(footer));
+    
+    return static_cast<bool>(fout);
+}
@@ -1,35 +1,392 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
+#include <optional>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//Формат: блоки с заголовком в один байт. Младший бит заголовка - тип блока, старшие семь - длина блока минус один.
+//Блок повтора (бит 1) содержит один байт, который повторяется длину раз, простой блок (бит 0) - сами байты
+const size_t RLE_MAX_BLOCK_SIZE = 128;
+const size_t RLE_MAX_EXPANSION = RLE_MAX_BLOCK_SIZE / 2; //блок повтора в два байта даёт не больше RLE_MAX_BLOCK_SIZE байт
+const size_t RLE_OUTPUT_BUFFER_SIZE = 1 << 20;
+const size_t RLE_INPUT_CHUNK_SIZE = 1 << 20;
+
+//Потоковый декодер: вход и выход подаются кусками любого размера, а блок, разрезанный границей куска,
+//запоминается и дописывается следующим вызовом
+class RleDecoder {
+public:
+    struct Result {
+        size_t consumed; //прочитано байт входа
+        size_t produced; //записано байт выхода
+    };
+    
+    Result Decode(std::string_view input, char* output, size_t output_size) {
+        const char* in = input.data();
+        const char* const in_end = in + input.size();
+        char* out = output;
+        char* const out_end = output + output_size;
+        
+        ContinueBlock(in, in_end, out, out_end);
+        
+        //Пока до концов буферов не меньше блока, блок копируется или заполняется целыми RLE_MAX_BLOCK_SIZE байтами:
+        //копирование постоянной длины компилятор разворачивает в векторные загрузки и записи без ветвлений,
+        //а лишние байты перезапишут следующие блоки
+        while (in_end - in > static_cast<ptrdiff_t>(RLE_MAX_BLOCK_SIZE) && out_end - out >= static_cast<ptrdiff_t>(RLE_MAX_BLOCK_SIZE)) {
+            const unsigned char header = static_cast<unsigned char>(*in++);
+            const size_t size = (header >> 1) + 1;
+            if (header & 1) {
+                std::memset(out, *in++, RLE_MAX_BLOCK_SIZE);
+            } else {
+                std::memcpy(out, in, RLE_MAX_BLOCK_SIZE);
+                in += size;
+            }
+            out += size;
+        }
+        
+        while (in != in_end && out != out_end && pending_size_ == 0) {
+            const unsigned char header = static_cast<unsigned char>(*in++);
+            pending_size_ = (header >> 1) + 1;
+            is_repeat_pending_ = header & 1;
+            is_repeat_byte_read_ = false;
+            ContinueBlock(in, in_end, out, out_end);
+        }
+        return {static_cast<size_t>(in - input.data()), static_cast<size_t>(out - output)};
+    }
+    
+    //вход закончился посреди блока
+    bool IsBlockPending() const { return pending_size_ != 0; }
+
+private:
+    void ContinueBlock(const char*& in, const char* in_end, char*& out, char* out_end) {
+        if (pending_size_ == 0) {
+            return;
+        }
+        if (is_repeat_pending_) {
+            if (!is_repeat_byte_read_) {
+                if (in == in_end) {
+                    return;
+                }
+                repeat_byte_ = *in++;
+                is_repeat_byte_read_ = true;
+            }
+            const size_t count = std::min<size_t>(pending_size_, out_end - out);
+            std::memset(out, repeat_byte_, count);
+            out += count;
+            pending_size_ -= count;
+            return;
+        }
+        const size_t count = std::min<size_t>({pending_size_, static_cast<size_t>(in_end - in), static_cast<size_t>(out_end - out)});
+        std::memcpy(out, in, count);
+        in += count;
+        out += count;
+        pending_size_ -= count;
+    }
+    
+    size_t pending_size_ = 0;
+    bool is_repeat_pending_ = false;
+    bool is_repeat_byte_read_ = false;
+    char repeat_byte_ = 0;
+};
+
+//Файл, отображённый в память только для чтения. Если отобразить не удалось (пустой файл, канал), IsMapped() ложно,
+//а файл остаётся открытым для чтения через GetDescriptor()
+class RleMappedFile {
+public:
+    explicit RleMappedFile(const std::string& path) : fd_(open(path.c_str(), O_RDONLY)) {
+        struct stat file_stat;
+        if (fd_ >= 0 && fstat(fd_, &file_stat) == 0 && S_ISREG(file_stat.st_mode) && file_stat.st_size > 0) {
+            void* data = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd_, 0);
+            if (data != MAP_FAILED) {
+                data_ = static_cast<const char*>(data);
+                size_ = file_stat.st_size;
+            }
+        }
+    }
+    ~RleMappedFile() {
+        if (data_) {
+            munmap(const_cast<char*>(data_), size_);
+        }
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+    }
+    
+    RleMappedFile(const RleMappedFile&) = delete;
+    RleMappedFile& operator=(const RleMappedFile&) = delete;
+    
+    bool IsOpen() const { return fd_ >= 0; }
+    bool IsMapped() const { return data_ != nullptr; }
+    int GetDescriptor() const { return fd_; }
+    std::string_view GetData() const { return {data_, size_}; }
+
+private:
+    int fd_;
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+//Кадрированный формат: данные делятся на куски по RLE_FRAME_CHUNK_SIZE байт, каждый кодируется независимо,
+//за кусками идёт индекс - RleChunkIndexEntry на кусок - и RleFrameFooter. Числа записаны в родном порядке байт.
+//Старый формат распознаётся по отсутствию подписи и согласованного с размером файла индекса в конце
+const size_t RLE_FRAME_CHUNK_SIZE = 1 << 20;
+const char RLE_FRAME_MAGIC[8] = {'R', 'L', 'E', 'F', 'R', 'A', 'M', 'E'};
+const uint64_t RLE_FNV_OFFSET_BASIS = 14695981039346656037ull;
+const uint64_t RLE_FNV_PRIME = 1099511628211ull;
+
+struct RleChunkIndexEntry {
+    uint64_t compressed_offset;
+    uint64_t decompressed_offset;
+    uint64_t checksum; //ComputeRLEChecksum распакованного куска
+};
+
+struct RleFrameFooter {
+    uint64_t chunk_count;
+    uint64_t decompressed_size;
+    uint64_t index_checksum; //ComputeRLEChecksum записей индекса
+    char magic[8];
+};
+
+struct RleFrameIndex {
+    std::vector<RleChunkIndexEntry> chunks;
+    uint64_t compressed_size = 0; //конец последнего куска, он же начало индекса
+    uint64_t decompressed_size = 0;
+    
+    uint64_t GetChunkCompressedEnd(size_t chunk) const {
+        return chunk + 1 < chunks.size() ? chunks[chunk + 1].compressed_offset : compressed_size;
+    }
+    uint64_t GetChunkDecompressedEnd(size_t chunk) const {
+        return chunk + 1 < chunks.size() ? chunks[chunk + 1].decompressed_offset : decompressed_size;
+    }
+};
+
+//FNV-1a по 8-байтным словам и по байтам хвоста
+inline uint64_t ComputeRLEChecksum(const char* data, size_t size) {
+    uint64_t checksum = RLE_FNV_OFFSET_BASIS;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        checksum = (checksum ^ word) * RLE_FNV_PRIME;
+    }
+    for (; i < size; ++i) {
+        checksum = (checksum ^ static_cast<unsigned char>(data[i])) * RLE_FNV_PRIME;
+    }
+    return checksum;
+}
+
+//индекс кадрированного архива; nullopt, если архив в старом формате
+inline std::optional<RleFrameIndex> ParseRLEFrameIndex(std::string_view archive) {
+    RleFrameFooter footer;
+    if (archive.size() < sizeof(footer)) {
+        return std::nullopt;
+    }
+    std::memcpy(&footer, archive.data() + archive.size() - sizeof(footer), sizeof(footer));
+    const uint64_t max_chunk_count = (archive.size() - sizeof(footer)) / sizeof(RleChunkIndexEntry);
+    if (std::memcmp(footer.magic, RLE_FRAME_MAGIC, sizeof(footer.magic)) != 0 || footer.chunk_count > max_chunk_count) {
+        return std::nullopt;
+    }
+    
+    RleFrameIndex index;
+    const size_t index_size = footer.chunk_count * sizeof(RleChunkIndexEntry);
+    index.compressed_size = archive.size() - sizeof(footer) - index_size;
+    index.decompressed_size = footer.decompressed_size;
+    const char* index_data = archive.data() + index.compressed_size;
+    if (ComputeRLEChecksum(index_data, index_size) != footer.index_checksum) {
+        return std::nullopt;
+    }
+    index.chunks.resize(footer.chunk_count);
+    std::memcpy(index.chunks.data(), index_data, index_size);
+    
+    if (index.chunks.empty() && (index.compressed_size != 0 || index.decompressed_size != 0)) {
+        return std::nullopt;
+    }
+    //смещения кусков идут по возрастанию от нуля и не выходят за данные, а кусок распаковывается не больше,
+    //чем в RLE_MAX_EXPANSION раз: иначе подделанный индекс заставил бы выделять под кусок сколько угодно памяти
+    for (size_t i = 0; i < index.chunks.size(); ++i) {
+        const RleChunkIndexEntry& chunk = index.chunks[i];
+        const bool is_first_valid = i != 0 || (chunk.compressed_offset == 0 && chunk.decompressed_offset == 0);
+        if (!is_first_valid || chunk.compressed_offset > index.GetChunkCompressedEnd(i)
+                || chunk.decompressed_offset > index.GetChunkDecompressedEnd(i)
+                || index.GetChunkDecompressedEnd(i) - chunk.decompressed_offset
+                    > (index.GetChunkCompressedEnd(i) - chunk.compressed_offset) * RLE_MAX_EXPANSION) {
+            return std::nullopt;
+        }
+    }
+    return index;
+}
+
+//распаковывает кусок chunk в output, где должно помещаться столько байт, сколько в куске; false, если кусок повреждён
+inline bool DecodeRLEChunk(std::string_view archive, const RleFrameIndex& index, size_t chunk, char* output) {
+    const uint64_t compressed_offset = index.chunks[chunk].compressed_offset;
+    const std::string_view input = archive.substr(compressed_offset, index.GetChunkCompressedEnd(chunk) - compressed_offset);
+    const size_t size = index.GetChunkDecompressedEnd(chunk) - index.chunks[chunk].decompressed_offset;
+    RleDecoder decoder;
+    const RleDecoder::Result result = decoder.Decode(input, output, size);
+    return result.consumed == input.size() && result.produced == size && !decoder.IsBlockPending()
+        && ComputeRLEChecksum(output, size) == index.chunks[chunk].checksum;
+}
+
+//Куски распаковываются всеми ядрами: поток берёт следующий свободный кусок, распаковывает его в свой буфер
+//и пишет на его место в выходном файле. false, если кусок повреждён, запись не удалась или не хватило памяти:
+//исключение, вышедшее из потока, завершило бы программу, поэтому поток ловит его сам
+inline bool DecodeRLEChunks(std::string_view archive, const RleFrameIndex& index, int output_fd) {
+    std::atomic<size_t> next_chunk{0};
+    std::atomic<bool> is_ok{true};
+    auto worker = [&]() {
+        try {
+            std::vector<char> buffer;
+            for (size_t chunk; is_ok && (chunk = next_chunk++) < index.chunks.size(); ) {
+                buffer.resize(index.GetChunkDecompressedEnd(chunk) - index.chunks[chunk].decompressed_offset);
+                if (!DecodeRLEChunk(archive, index, chunk, buffer.data())) {
+                    is_ok = false;
+                    break;
+                }
+                size_t written = 0;
+                while (written < buffer.size()) {
+                    const ssize_t size = pwrite(output_fd, buffer.data() + written, buffer.size() - written,
+                                                index.chunks[chunk].decompressed_offset + written);
+                    if (size <= 0) {
+                        is_ok = false;
+                        break;
+                    }
+                    written += size;
+                }
+            }
+        } catch (...) {
+            is_ok = false;
+        }
+    };
+    
+    const size_t thread_count = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), index.chunks.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < thread_count; ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    return is_ok;
+}
+
+//Кадрированный архив распаковывается параллельно, DecodeRLEChunks, и тогда false означает ещё и повреждённый архив;
+//для этого он должен быть обычным файлом. Старый формат отображается в память целиком, а если это не удаётся
+//(например, это канал) - читается кусками по RLE_INPUT_CHUNK_SIZE. Выход копится в буфере на RLE_OUTPUT_BUFFER_SIZE
+//и пишется большими кусками. Если старый архив обрывается посреди простого блока, записываются байты, которые в нём есть;
+//оборванный блок повтора пропускается
 inline bool DecodeRLE(const std::string& src_name, const std::string& dst_name) {
     using namespace std;
     
-    ifstream fin(src_name, ios::in | ios::binary);
-    if (!fin) {
+    const RleMappedFile src(src_name);
+    if (!src.IsOpen()) {
         return false;
     }
     
+    if (src.IsMapped()) {
+        if (const optional<RleFrameIndex> index = ParseRLEFrameIndex(src.GetData())) {
+            const int output_fd = open(dst_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (output_fd < 0) {
+                return false;
+            }
+            const bool is_ok = ftruncate(output_fd, index->decompressed_size) == 0 && DecodeRLEChunks(src.GetData(), *index, output_fd);
+            close(output_fd);
+            return is_ok;
+        }
+    }
+    
     ofstream fout(dst_name, ios::out | ios::binary);
+    RleDecoder decoder;
+    vector<char> buffer(RLE_OUTPUT_BUFFER_SIZE);
+    //блок повтора дописывается и без входа, поэтому декодирование идёт, пока буфер выхода заполняется целиком
+    auto decode = [&](string_view input) {
+        RleDecoder::Result result;
+        do {
+            result = decoder.Decode(input, buffer.data(), buffer.size());
+            fout.write(buffer.data(), result.produced);
+            input.remove_prefix(result.consumed);
+        } while (!input.empty() || result.produced == buffer.size());
+    };
     
-    do {
-        char buff[1024];
-        unsigned char header = fin.get();
-        if (!fin) {
-            break;
-        }
-        
-        int block_type = (header & 1);
-        int data_size = (header >> 1) + 1;
-        if (block_type) {
-            string str(data_size, fin.get());
-            fout.write(&str[0], data_size);
-        } else {
-            fin.read(buff, data_size);
-            fout.write(buff, fin.gcount());
+    if (src.IsMapped()) {
+        madvise(const_cast<char*>(src.GetData().data()), src.GetData().size(), MADV_SEQUENTIAL);
+        decode(src.GetData());
+    } else {
+        vector<char> chunk(RLE_INPUT_CHUNK_SIZE);
+        ssize_t size;
+        while ((size = read(src.GetDescriptor(), chunk.data(), chunk.size())) > 0) {
+            decode({chunk.data(), static_cast<size_t>(size)});
         }
-    } while (fin);
+    }
     
     return true;
 }
+
+//Произвольный доступ к кадрированному архиву: читаются только куски, задевающие нужный диапазон
+class RleFramedReader {
+public:
+    //runtime_error, если файл не открывается или это не кадрированный архив
+    explicit RleFramedReader(const std::string& path) : file_(path) {
+        using namespace std::string_literals;
+        std::optional<RleFrameIndex> index;
+        if (file_.IsMapped()) {
+            index = ParseRLEFrameIndex(file_.GetData());
+        }
+        if (!index) {
+            throw std::runtime_error("cannot open "s + path + " as a framed RLE archive"s);
+        }
+        index_ = std::move(*index);
+    }
+    
+    uint64_t GetSize() const { return index_.decompressed_size; }
+    
+    //Копирует в output распакованные байты [offset, offset + size), обрезанные по концу данных, и возвращает их число.
+    //Куски, целиком попавшие в диапазон, распаковываются прямо в output. runtime_error, если кусок повреждён
+    size_t Read(uint64_t offset, char* output, size_t size) const {
+        using namespace std::string_literals;
+        if (offset >= index_.decompressed_size) {
+            return 0;
+        }
+        const uint64_t end = std::min<uint64_t>(offset + size, index_.decompressed_size);
+        size_t chunk = std::upper_bound(index_.chunks.begin(), index_.chunks.end(), offset, [](uint64_t offset, const RleChunkIndexEntry& entry) {
+            return offset < entry.decompressed_offset;
+        }) - index_.chunks.begin() - 1;
+        
+        std::vector<char> buffer;
+        for (uint64_t pos = offset; pos < end; ++chunk) {
+            const uint64_t chunk_begin = index_.chunks[chunk].decompressed_offset;
+            const uint64_t chunk_end = index_.GetChunkDecompressedEnd(chunk);
+            char* target = output + (pos - offset);
+            if (chunk_begin != pos || chunk_end > end) {
+                buffer.resize(chunk_end - chunk_begin);
+                target = buffer.data();
+            }
+            if (!DecodeRLEChunk(file_.GetData(), index_, chunk, target)) {
+                throw std::runtime_error("framed RLE chunk "s + std::to_string(chunk) + " is corrupted"s);
+            }
+            const uint64_t copy_end = std::min(chunk_end, end);
+            if (target == buffer.data()) {
+                std::memcpy(output + (pos - offset), buffer.data() + (pos - chunk_begin), copy_end - pos);
+            }
+            pos = copy_end;
+        }
+        return end - offset;
+    }
+
+private:
+    RleMappedFile file_;
+    RleFrameIndex index_;
+};
@@ -1,10 +1,17 @@
 #include <algorithm>
 #include <cassert>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 using namespace std;
@@ -14,35 +21,198 @@ path operator""_p(const char* data, std::size_t sz) {
     return path(data, data + sz);
 }
 
+//Сколько прочитанных, но ещё не выведенных каталогов может накопиться: дальше потоки ждут, пока вывод их догонит
+const size_t PRINT_TREE_MAX_BUFFERED_DIRECTORIES = 4096;
+
+//Тип, как у dir_entry.status().type(), но без лишнего stat: directory_iterator уже знает тип записи,
+//и переходить по ссылке нужно только для символических ссылок
+filesystem::file_type GetEntryType(const filesystem::directory_entry& dir_entry) {
+    using filesystem::file_type;
+    if (dir_entry.is_symlink()) {
+        return dir_entry.status().type();
+    }
+    if (dir_entry.is_directory()) {
+        return file_type::directory;
+    }
+    if (dir_entry.is_regular_file()) {
+        return file_type::regular;
+    }
+    if (dir_entry.is_block_file()) {
+        return file_type::block;
+    }
+    if (dir_entry.is_character_file()) {
+        return file_type::character;
+    }
+    if (dir_entry.is_fifo()) {
+        return file_type::fifo;
+    }
+    if (dir_entry.is_socket()) {
+        return file_type::socket;
+    }
+    return dir_entry.status().type();
+}
+
+struct DirectoryNode;
+
 struct EntryInfo {
-    path path_;
+    string name_; //имя считается один раз, а не при каждом сравнении
     filesystem::file_type type_;
+    unique_ptr<DirectoryNode> directory_; //только у каталогов
+};
+
+struct DirectoryNode {
+    path path_;
+    vector<uint32_t> order_; //номера каталога и его предков среди отсортированных соседей - место в выводе
+    vector<EntryInfo> entries_;
+    exception_ptr error_;
+    bool is_taken_ = false;
+    bool is_listed_ = false;
 };
 
-void PrintTree(ostream& dst, const path& p, int offset) {
-    dst << string(offset, ' ') << p.filename().string() << "\n";
+//Каталоги читаются несколькими потоками, а выводит их один, в порядке обхода в глубину, и выведенное сразу освобождается.
+//Ожидающие чтения каталоги лежат в общей очереди по месту в выводе, поэтому первым всегда берётся тот,
+//до которого вывод дойдёт раньше, а число прочитанных впрок ограничено PRINT_TREE_MAX_BUFFERED_DIRECTORIES
+class TreePrinter {
+public:
+    TreePrinter(ostream& dst, const path& p) : dst_(dst), root_{p, {}, {}, {}} {
+        const size_t thread_count = max(1u, thread::hardware_concurrency());
+        for (size_t i = 1; i < thread_count; ++i) {
+            workers_.emplace_back([this]() {
+                Work();
+            });
+        }
+    }
 
-    vector<EntryInfo> dir_data;
-    for (const auto & dir_entry : filesystem::directory_iterator(p)) {
-        dir_data.emplace_back(dir_entry.path(), dir_entry.status().type());
+    ~TreePrinter() {
+        {
+            lock_guard guard(mutex_);
+            is_done_ = true;
+        }
+        work_ready_.notify_all();
+        for (thread& worker : workers_) {
+            worker.join();
+        }
     }
 
-    sort(dir_data.begin(), dir_data.end(), [](const EntryInfo& lhs, const EntryInfo& rhs) {
-        return (lhs.type_ > rhs.type_) ||
-               ((lhs.type_ == rhs.type_) && (lhs.path_.filename().string() > rhs.path_.filename().string()));
-    });
+    void Print() {
+        dst_ << root_.path_.filename().string() << "\n";
+        Print(root_, 0);
+    }
 
-    for (const auto& item : dir_data) {
-        if (item.type_ == filesystem::file_type::directory) {
-            PrintTree(dst, item.path_, offset + 2);
-        } else {
-            dst << string(offset + 2, ' ') << item.path_.filename().string() << "\n";
+private:
+    struct IsPrintedLater {
+        bool operator()(const DirectoryNode* lhs, const DirectoryNode* rhs) const {
+            return lhs->order_ > rhs->order_;
+        }
+    };
+
+    void Print(DirectoryNode& node, int offset) {
+        WaitListed(node);
+        if (node.error_) {
+            rethrow_exception(node.error_);
+        }
+        for (EntryInfo& item : node.entries_) {
+            dst_ << string(offset + 2, ' ') << item.name_ << "\n";
+            if (item.directory_) {
+                Print(*item.directory_, offset + 2);
+                item.directory_.reset();
+            }
+        }
+        if (&node != &root_) {
+            {
+                lock_guard guard(mutex_);
+                --buffered_count_;
+            }
+            work_ready_.notify_one();
         }
     }
-}
+
+    //если каталог ещё никто не взял, вывод читает его сам: он первый в очереди, так что ждать его нет смысла
+    void WaitListed(DirectoryNode& node) {
+        unique_lock lock(mutex_);
+        if (!node.is_taken_) {
+            if (&node != &root_) {
+                pending_.pop();
+            }
+            node.is_taken_ = true;
+            lock.unlock();
+            List(node);
+            return;
+        }
+        listed_.wait(lock, [&node]() {
+            return node.is_listed_;
+        });
+    }
+
+    void Work() {
+        unique_lock lock(mutex_);
+        while (true) {
+            work_ready_.wait(lock, [this]() {
+                return is_done_ || (!pending_.empty() && buffered_count_ < PRINT_TREE_MAX_BUFFERED_DIRECTORIES);
+            });
+            if (is_done_) {
+                return;
+            }
+            DirectoryNode* node = pending_.top();
+            pending_.pop();
+            node->is_taken_ = true;
+            lock.unlock();
+            List(*node);
+            lock.lock();
+        }
+    }
+
+    void List(DirectoryNode& node) {
+        try {
+            for (const auto& dir_entry : filesystem::directory_iterator(node.path_)) {
+                node.entries_.push_back({dir_entry.path().filename().string(), GetEntryType(dir_entry), nullptr});
+            }
+            sort(node.entries_.begin(), node.entries_.end(), [](const EntryInfo& lhs, const EntryInfo& rhs) {
+                return (lhs.type_ > rhs.type_) || ((lhs.type_ == rhs.type_) && (lhs.name_ > rhs.name_));
+            });
+            for (uint32_t i = 0; i < node.entries_.size(); ++i) {
+                EntryInfo& item = node.entries_[i];
+                if (item.type_ == filesystem::file_type::directory) {
+                    item.directory_ = make_unique<DirectoryNode>();
+                    item.directory_->path_ = node.path_ / item.name_;
+                    item.directory_->order_ = node.order_;
+                    item.directory_->order_.push_back(i);
+                }
+            }
+        } catch (...) {
+            node.error_ = current_exception();
+        }
+
+        {
+            lock_guard guard(mutex_);
+            for (EntryInfo& item : node.entries_) {
+                if (item.directory_) {
+                    pending_.push(item.directory_.get());
+                }
+            }
+            if (&node != &root_) {
+                ++buffered_count_;
+            }
+            node.is_listed_ = true;
+        }
+        listed_.notify_all();
+        work_ready_.notify_all();
+    }
+
+    ostream& dst_;
+    DirectoryNode root_;
+
+    mutex mutex_;
+    condition_variable work_ready_;
+    condition_variable listed_;
+    priority_queue<DirectoryNode*, vector<DirectoryNode*>, IsPrintedLater> pending_;
+    size_t buffered_count_ = 0;
+    bool is_done_ = false;
+    vector<thread> workers_;
+};
 
 void PrintTree(ostream& dst, const path& p) {
-    PrintTree(dst, p, 0);
+    TreePrinter(dst, p).Print();
 }
 
 int main() {
@@ -0,0 +1,73 @@
+#include "async_search.h"
+
+#include <stdexcept>
+
+using namespace std::string_literals;
+
+AsyncSearcher::AsyncSearcher(const SearchServer& search_server, size_t thread_count, size_t queue_capacity)
+    : search_server_(search_server),
+      queue_capacity_(queue_capacity) {
+    if (thread_count == 0) {
+        throw std::invalid_argument("thread count must be positive"s);
+    }
+    for (size_t i = 0; i < thread_count; ++i) {
+        workers_.emplace_back([this]() {
+            Work();
+        });
+    }
+}
+
+AsyncSearcher::~AsyncSearcher() {
+    {
+        std::lock_guard guard(mutex_);
+        is_stopping_ = true;
+    }
+    task_ready_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+std::future<SearchResult> AsyncSearcher::FindTopDocuments(std::string raw_query, DocumentStatus sought_status, size_t top_count,
+                                                          std::chrono::steady_clock::time_point deadline, CancellationToken token) {
+    return FindTopDocuments(std::move(raw_query), SearchServer::StatusPredicate{sought_status}, top_count, deadline, std::move(token));
+}
+
+size_t AsyncSearcher::GetRejectedCount() const {
+    std::lock_guard guard(mutex_);
+    return rejected_count_;
+}
+
+std::future<SearchResult> AsyncSearcher::Submit(std::shared_ptr<std::packaged_task<SearchResult()>> task) {
+    std::future<SearchResult> result = task->get_future();
+    {
+        std::lock_guard guard(mutex_);
+        if (tasks_.size() >= queue_capacity_) {
+            ++rejected_count_;
+            throw std::runtime_error("async search queue is full"s);
+        }
+        tasks_.push([task]() {
+            (*task)();
+        });
+    }
+    task_ready_.notify_one();
+    return result;
+}
+
+void AsyncSearcher::Work() {
+    std::unique_lock lock(mutex_);
+    while (true) {
+        task_ready_.wait(lock, [this]() {
+            return is_stopping_ || !tasks_.empty();
+        });
+        //принятые запросы выполняются и при остановке: их future уже отданы
+        if (tasks_.empty()) {
+            return;
+        }
+        std::function<void()> task = std::move(tasks_.front());
+        tasks_.pop();
+        lock.unlock();
+        task();
+        lock.lock();
+    }
+}
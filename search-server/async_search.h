@@ -0,0 +1,68 @@
+#pragma once
+
+#include "cancellation_token.h"
+#include "document.h"
+#include "search_server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+const size_t ASYNC_SEARCH_QUEUE_CAPACITY = 1024;
+
+//Асинхронный поиск со сроком на своём пуле из thread_count потоков; каждый запрос выполняется последовательно, в одном потоке.
+//Очередь ждущих запросов ограничена queue_capacity: запрос сверх неё сразу отвергается исключением runtime_error,
+//так что при перегрузке лишнее сбрасывается, а не копится. Запрос, чей срок вышел или который отменили, пока он ждал в очереди,
+//не выполняется и отдаёт пустую неполную выдачу. Сервер не должен меняться, пока есть незавершённые запросы;
+//деструктор дожидается всех принятых
+class AsyncSearcher {
+public:
+    explicit AsyncSearcher(const SearchServer& search_server, size_t thread_count = std::max(1u, std::thread::hardware_concurrency()),
+                           size_t queue_capacity = ASYNC_SEARCH_QUEUE_CAPACITY);
+    ~AsyncSearcher();
+    
+    AsyncSearcher(const AsyncSearcher&) = delete;
+    AsyncSearcher& operator=(const AsyncSearcher&) = delete;
+    
+    //ошибки разбора запроса передаются через future
+    template <typename DocumentPredicate>
+    std::future<SearchResult> FindTopDocuments(std::string raw_query, DocumentPredicate predicate, size_t top_count,
+                                               std::chrono::steady_clock::time_point deadline, CancellationToken token = {});
+    std::future<SearchResult> FindTopDocuments(std::string raw_query, DocumentStatus sought_status, size_t top_count,
+                                               std::chrono::steady_clock::time_point deadline, CancellationToken token = {});
+    
+    //сколько запросов отвергнуто из-за полной очереди
+    size_t GetRejectedCount() const;
+
+private:
+    //задача копируемая, как того требует std::function, поэтому packaged_task лежит за shared_ptr
+    std::future<SearchResult> Submit(std::shared_ptr<std::packaged_task<SearchResult()>> task);
+    void Work();
+    
+    const SearchServer& search_server_;
+    const size_t queue_capacity_;
+    
+    mutable std::mutex mutex_;
+    std::condition_variable task_ready_;
+    std::queue<std::function<void()>> tasks_;
+    size_t rejected_count_ = 0;
+    bool is_stopping_ = false;
+    std::vector<std::thread> workers_;
+};
+
+template <typename DocumentPredicate>
+std::future<SearchResult> AsyncSearcher::FindTopDocuments(std::string raw_query, DocumentPredicate predicate, size_t top_count,
+                                                          std::chrono::steady_clock::time_point deadline, CancellationToken token) {
+    return Submit(std::make_shared<std::packaged_task<SearchResult()>>(
+        [this, raw_query = std::move(raw_query), predicate, top_count, deadline, token = std::move(token)]() {
+            return search_server_.FindTopDocuments(std::execution::seq, raw_query, predicate, top_count, deadline, token);
+        }));
+}
@@ -0,0 +1,391 @@
+#include "../async_search.h"
+#include "../paginator.h"
+#include "../request_queue.h"
+#include "../search_server.h"
+#include "../sharded_search_server.h"
+#include "../string_processing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <memory_resource>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+//счётчик выделений памяти: каждый operator new в программе проходит через него
+static std::atomic<size_t> allocation_count{0};
+
+//operator new здесь сам выделяет через malloc, так что free в delete парный ему; GCC, встроив delete после new,
+//видит только пару new/free и ложно предупреждает о несовпадении
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(size_t size) {
+    ++allocation_count;
+    if (void* ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+void operator delete[](void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+//выровненные версии: через них выделяет память std::pmr::new_delete_resource
+void* operator new(size_t size, std::align_val_t alignment) {
+    ++allocation_count;
+    const size_t align = static_cast<size_t>(alignment);
+    if (void* ptr = std::aligned_alloc(align, (std::max<size_t>(size, 1) + align - 1) / align * align)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+void operator delete(void* ptr, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+void operator delete[](void* ptr, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+//синтетический корпус: слова словаря выбираются с распределением, близким к закону Ципфа,
+//поэтому в запросах встречаются и частые, и редкие слова
+struct Corpus {
+    std::vector<std::string> documents;
+    std::vector<std::vector<int>> ratings;
+    std::vector<std::string> queries;
+};
+
+Corpus GenerateCorpus(size_t document_count, size_t query_count, uint32_t seed) {
+    const size_t DICTIONARY_SIZE = 20000;
+    const size_t WORDS_PER_DOCUMENT = 10;
+    const size_t WORDS_PER_QUERY = 5;
+    
+    std::mt19937 generator(seed);
+    std::vector<std::string> dictionary;
+    for (size_t i = 0; i < DICTIONARY_SIZE; ++i) {
+        std::string word;
+        const int length = 3 + generator() % 6;
+        for (int j = 0; j < length; ++j) {
+            word += static_cast<char>('a' + generator() % 26);
+        }
+        dictionary.push_back(word);
+    }
+    
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    auto random_word = [&]() -> const std::string& {
+        return dictionary[static_cast<size_t>(std::pow(static_cast<double>(DICTIONARY_SIZE), uniform(generator))) - 1];
+    };
+    
+    Corpus corpus;
+    for (size_t i = 0; i < document_count; ++i) {
+        std::string document;
+        for (size_t j = 0; j < WORDS_PER_DOCUMENT; ++j) {
+            document += random_word();
+            document += ' ';
+        }
+        corpus.documents.push_back(document);
+        corpus.ratings.push_back({static_cast<int>(generator() % 10), static_cast<int>(generator() % 10)});
+    }
+    for (size_t i = 0; i < query_count; ++i) {
+        std::string query;
+        for (size_t j = 0; j < WORDS_PER_QUERY; ++j) {
+            query += random_word();
+            query += ' ';
+        }
+        query += '-';
+        query += random_word();
+        corpus.queries.push_back(query);
+    }
+    return corpus;
+}
+
+//прогоняет operation(i) для i из [0, op_count) и печатает строку CSV:
+//benchmark,corpus_size,ops,ns_per_op,allocs_per_op,ops_per_sec,gb_per_sec; gb_per_sec - только у операций, обрабатывающих bytes_per_op байт
+template <typename Operation>
+void Run(std::ostream& out, const std::string& name, size_t corpus_size, size_t op_count, Operation operation, size_t bytes_per_op = 0) {
+    const size_t allocations_before = allocation_count;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < op_count; ++i) {
+        operation(i);
+    }
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    const size_t allocations = allocation_count - allocations_before;
+    
+    out << name << ',' << corpus_size << ',' << op_count << ','
+        << ns / op_count << ',' << static_cast<double>(allocations) / op_count << ',' << op_count * 1e9 / ns << ',';
+    if (bytes_per_op > 0) {
+        out << bytes_per_op * op_count / ns;
+    }
+    out << std::endl;
+}
+
+//те же запросы, в которых плюс-слова обрезаны до префиксов из prefix_size букв
+std::vector<std::string> MakePrefixQueries(const std::vector<std::string>& queries, size_t prefix_size) {
+    using namespace std::string_literals;
+    
+    std::vector<std::string> prefix_queries;
+    for (const std::string& query : queries) {
+        std::string prefix_query;
+        for (const std::string_view word : SplitIntoWordsView(query)) {
+            prefix_query += word[0] == '-' ? word : word.substr(0, prefix_size);
+            prefix_query += word[0] == '-' ? " "s : "* "s;
+        }
+        prefix_queries.push_back(prefix_query);
+    }
+    return prefix_queries;
+}
+
+//запускает shard_count процессов с шардами; процесс завершается сам, когда закрывается соединение с ним
+std::vector<std::unique_ptr<SearchShard>> StartSocketShards(const std::string& stop_words, size_t shard_count, std::vector<pid_t>& shard_processes) {
+    using namespace std::string_literals;
+    
+    std::vector<std::unique_ptr<SearchShard>> shards;
+    for (size_t i = 0; i < shard_count; ++i) {
+        const std::string socket_path = "/tmp/search_benchmark_"s + std::to_string(getpid()) + "_"s + std::to_string(i) + ".sock"s;
+        const pid_t pid = fork();
+        if (pid == 0) {
+            SearchServer shard_server(stop_words);
+            ServeSearchShard(shard_server, socket_path);
+            _exit(0);
+        }
+        shard_processes.push_back(pid);
+        shards.push_back(std::make_unique<SocketSearchShard>(socket_path));
+    }
+    return shards;
+}
+
+void RunBenchmarks(std::ostream& out, size_t document_count, size_t query_count, uint32_t seed) {
+    using namespace std::string_literals;
+    
+    const Corpus corpus = GenerateCorpus(document_count, query_count, seed);
+    const size_t query_total = corpus.queries.size();
+    
+    //токенизатор на всём тексте корпуса сразу, TOKENIZER_PASSES проходов
+    const size_t TOKENIZER_PASSES = 10;
+    std::string text;
+    for (const std::string& document : corpus.documents) {
+        text += document;
+    }
+    size_t word_count = 0;
+    Run(out, "SplitIntoWordsView"s, document_count, TOKENIZER_PASSES, [&](size_t) {
+        word_count += SplitIntoWordsView(text).size();
+    }, text.size());
+    Run(out, "SplitIntoWords"s, document_count, TOKENIZER_PASSES, [&](size_t) {
+        word_count += SplitIntoWords(text).size();
+    }, text.size());
+    
+    SearchServer search_server("and in at"s);
+    Run(out, "AddDocument"s, document_count, document_count, [&](size_t i) {
+        search_server.AddDocument(static_cast<int>(i), corpus.documents[i], DocumentStatus::ACTUAL, corpus.ratings[i]);
+    });
+    
+    //узлы индекса берутся из пула, а не по одному у operator new
+    std::pmr::unsynchronized_pool_resource pool;
+    SearchServer pooled_server("and in at"s, &pool);
+    Run(out, "AddDocumentPooled"s, document_count, document_count, [&](size_t i) {
+        pooled_server.AddDocument(static_cast<int>(i), corpus.documents[i], DocumentStatus::ACTUAL, corpus.ratings[i]);
+    });
+    
+    //пакет загружается целиком на первой операции, а время делится на все документы, чтобы строки были сравнимы с AddDocument
+    std::vector<NewDocument> batch;
+    for (size_t i = 0; i < document_count; ++i) {
+        batch.push_back({static_cast<int>(i), corpus.documents[i], DocumentStatus::ACTUAL, corpus.ratings[i]});
+    }
+    SearchServer bulk_server("and in at"s);
+    Run(out, "AddDocuments"s, document_count, document_count, [&](size_t i) {
+        if (i == 0) {
+            bulk_server.AddDocuments(batch);
+        }
+    });
+    
+    size_t found = 0;
+    Run(out, "FindTopDocuments"s, document_count, query_total, [&](size_t i) {
+        found += search_server.FindTopDocuments(corpus.queries[i]).size();
+    });
+    Run(out, "FindTopDocumentsPredicate"s, document_count, query_total, [&](size_t i) {
+        found += search_server.FindTopDocuments(corpus.queries[i], [](int document_id, DocumentStatus, int rating) {
+            return document_id % 2 == 0 && rating > 2;
+        }).size();
+    });
+    Run(out, "FindTopDocumentsPar"s, document_count, query_total, [&](size_t i) {
+        found += search_server.FindTopDocuments(std::execution::par, corpus.queries[i]).size();
+    });
+    
+    //строки стоит сравнивать с FindTopDocuments. В трёхбуквенный префикс входит несколько слов словаря,
+    //а однобуквенный раскрывается до MAX_PREFIX_EXPANSION_COUNT слов, среди которых есть и частые
+    const std::vector<std::string> prefix_queries = MakePrefixQueries(corpus.queries, 3);
+    Run(out, "FindTopDocumentsPrefix"s, document_count, query_total, [&](size_t i) {
+        found += search_server.FindTopDocuments(prefix_queries[i]).size();
+    });
+    const std::vector<std::string> wide_prefix_queries = MakePrefixQueries(corpus.queries, 1);
+    Run(out, "FindTopDocumentsWidePrefix"s, document_count, query_total, [&](size_t i) {
+        found += search_server.FindTopDocuments(wide_prefix_queries[i]).size();
+    });
+    
+    //срок с запасом, так что запросы не прерываются: строка показывает цену проверок срока по сравнению с FindTopDocuments
+    const auto DEADLINE_DURATION = std::chrono::seconds(10);
+    Run(out, "FindTopDocumentsDeadline"s, document_count, query_total, [&](size_t i) {
+        found += search_server.FindTopDocuments(std::execution::seq, corpus.queries[i], DocumentStatus::ACTUAL, MAX_RESULT_DOCUMENT_COUNT,
+                                                std::chrono::steady_clock::now() + DEADLINE_DURATION).documents.size();
+    });
+    //Срок в TIGHT_DEADLINE_DURATION на запросах с однобуквенными префиксами истекает посреди поиска, и выдача бывает неполной:
+    //строку стоит сравнивать с FindTopDocumentsWidePrefix, а число неполных выдач печатается отдельно
+    const auto TIGHT_DEADLINE_DURATION = std::chrono::microseconds(200);
+    size_t partial_count = 0;
+    Run(out, "FindTopDocumentsTightDeadline"s, document_count, query_total, [&](size_t i) {
+        const SearchResult result = search_server.FindTopDocuments(std::execution::seq, wide_prefix_queries[i], DocumentStatus::ACTUAL,
+                                                                   MAX_RESULT_DOCUMENT_COUNT, std::chrono::steady_clock::now() + TIGHT_DEADLINE_DURATION);
+        found += result.documents.size();
+        partial_count += result.is_partial;
+    });
+    std::cerr << "corpus " << document_count << ": " << partial_count << " of " << query_total << " partial results with a tight deadline" << std::endl;
+    //все запросы отправляются пулу сразу, а результаты собираются на последней операции; очередь вмещает их все
+    {
+        AsyncSearcher searcher(search_server, std::max(1u, std::thread::hardware_concurrency()), query_total);
+        std::vector<std::future<SearchResult>> results;
+        Run(out, "AsyncFindTopDocuments"s, document_count, query_total, [&](size_t i) {
+            results.push_back(searcher.FindTopDocuments(corpus.queries[i], DocumentStatus::ACTUAL, MAX_RESULT_DOCUMENT_COUNT,
+                                                        std::chrono::steady_clock::now() + DEADLINE_DURATION));
+            if (i + 1 == query_total) {
+                for (std::future<SearchResult>& result : results) {
+                    found += result.get().documents.size();
+                }
+            }
+        });
+    }
+    
+    Run(out, "MatchDocument"s, document_count, query_total, [&](size_t i) {
+        found += std::get<0>(search_server.MatchDocument(corpus.queries[i], static_cast<int>(i % document_count))).size();
+    });
+    Run(out, "MatchDocumentPar"s, document_count, query_total, [&](size_t i) {
+        found += std::get<0>(search_server.MatchDocument(std::execution::par, corpus.queries[i], static_cast<int>(i % document_count))).size();
+    });
+    
+    //те же запросы к сжатым спискам постингов: в bulk_server те же документы, что и в search_server
+    size_t posting_count = 0;
+    for (const int document_id : search_server) {
+        posting_count += search_server.GetWordFrequencies(document_id).size();
+    }
+    const size_t uncompressed_bytes = bulk_server.GetPostingsMemoryUsage();
+    bulk_server.CompressPostings();
+    std::cerr << "corpus " << document_count << ": " << uncompressed_bytes * 1.0 / posting_count << " bytes per posting, compressed "
+              << bulk_server.GetPostingsMemoryUsage() * 1.0 / posting_count << std::endl;
+    Run(out, "FindTopDocumentsCompressed"s, document_count, query_total, [&](size_t i) {
+        found += bulk_server.FindTopDocuments(corpus.queries[i]).size();
+    });
+    Run(out, "MatchDocumentCompressed"s, document_count, query_total, [&](size_t i) {
+        found += std::get<0>(bulk_server.MatchDocument(corpus.queries[i], static_cast<int>(i % document_count))).size();
+    });
+    
+    RequestQueue request_queue(search_server);
+    Run(out, "RequestQueue"s, document_count, query_total, [&](size_t i) {
+        found += request_queue.AddFindRequest(corpus.queries[i]).size();
+    });
+    
+    const size_t PAGE_SIZE = 10;
+    const size_t PAGINATED_RESULTS = 1000;
+    Run(out, "Paginate"s, document_count, query_total, [&](size_t i) {
+        const std::vector<Document> documents = search_server.FindTopDocuments(corpus.queries[i], DocumentStatus::ACTUAL, PAGINATED_RESULTS);
+        found += Paginate(documents, PAGE_SIZE).size();
+    });
+    //Страница за первыми DEEP_PAGE_OFFSET результатами: без курсора её приходится искать среди лучших DEEP_PAGE_OFFSET + PAGE_SIZE,
+    //с курсором, сохранённым после предыдущей страницы, - только среди PAGE_SIZE документов за ним
+    const size_t DEEP_PAGE_OFFSET = 500;
+    Run(out, "DeepPage"s, document_count, query_total, [&](size_t i) {
+        const std::vector<Document> documents = search_server.FindTopDocuments(corpus.queries[i], DocumentStatus::ACTUAL, DEEP_PAGE_OFFSET + PAGE_SIZE);
+        found += documents.size() - std::min(documents.size(), DEEP_PAGE_OFFSET);
+    });
+    std::vector<SearchServer::PageCursor> cursors(query_total);
+    for (size_t i = 0; i < query_total; ++i) {
+        found += search_server.FindNextPage(corpus.queries[i], DocumentStatus::ACTUAL, DEEP_PAGE_OFFSET, cursors[i]).size();
+    }
+    Run(out, "DeepPageCursor"s, document_count, query_total, [&](size_t i) {
+        SearchServer::PageCursor cursor = cursors[i];
+        found += search_server.FindNextPage(corpus.queries[i], DocumentStatus::ACTUAL, PAGE_SIZE, cursor).size();
+    });
+    
+    //Пропускная способность при росте числа шардов. Шарды опрашиваются параллельно, так что рост упирается
+    //в число ядер; строки с сокетами добавляют к этому стоимость двух обменов сообщениями с каждым шардом
+    for (const size_t shard_count : {1, 2, 4}) {
+        ShardedSearchServer sharded_server(""s, shard_count);
+        for (size_t i = 0; i < document_count; ++i) {
+            sharded_server.AddDocument(static_cast<int>(i), corpus.documents[i], DocumentStatus::ACTUAL, corpus.ratings[i]);
+        }
+        Run(out, "ShardedFindTopDocuments"s + std::to_string(shard_count), document_count, query_total, [&](size_t i) {
+            found += sharded_server.FindTopDocuments(std::execution::par, corpus.queries[i]).size();
+        });
+    }
+    for (const size_t shard_count : {1, 2, 4}) {
+        std::vector<pid_t> shard_processes;
+        {
+            ShardedSearchServer sharded_server(""s, StartSocketShards(""s, shard_count, shard_processes));
+            for (size_t i = 0; i < document_count; ++i) {
+                sharded_server.AddDocument(static_cast<int>(i), corpus.documents[i], DocumentStatus::ACTUAL, corpus.ratings[i]);
+            }
+            Run(out, "SocketShardedFindTopDocuments"s + std::to_string(shard_count), document_count, query_total, [&](size_t i) {
+                found += sharded_server.FindTopDocuments(std::execution::par, corpus.queries[i]).size();
+            });
+        }
+        //соединения закрыты, процессы шардов завершаются сами
+        for (const pid_t pid : shard_processes) {
+            waitpid(pid, nullptr, 0);
+        }
+    }
+    
+    //счётчик найденного не даёт компилятору выбросить вызовы
+    std::cerr << "corpus " << document_count << ": " << found << " results, " << word_count << " words" << std::endl;
+}
+
+//использование: benchmark [seed [query_count [corpus_size...]]]
+int main(int argc, char* argv[]) {
+    const uint32_t seed = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 42;
+    const size_t query_count = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1000;
+    std::vector<size_t> corpus_sizes;
+    for (int i = 3; i < argc; ++i) {
+        corpus_sizes.push_back(std::strtoul(argv[i], nullptr, 10));
+    }
+    if (corpus_sizes.empty()) {
+        corpus_sizes = {1000, 10000, 100000};
+    }
+    
+    std::cout << "benchmark,corpus_size,ops,ns_per_op,allocs_per_op,ops_per_sec,gb_per_sec" << std::endl;
+    for (const size_t corpus_size : corpus_sizes) {
+        RunBenchmarks(std::cout, corpus_size, query_count, seed);
+    }
+    return 0;
+}
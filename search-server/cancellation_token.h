@@ -0,0 +1,18 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+//Флаг отмены запроса, общий для всех копий: копия уходит вместе с запросом, а отменить его можно через любую другую
+class CancellationToken {
+public:
+    void Cancel() const {
+        is_cancelled_->store(true, std::memory_order_relaxed);
+    }
+    bool IsCancelled() const {
+        return is_cancelled_->load(std::memory_order_relaxed);
+    }
+
+private:
+    std::shared_ptr<std::atomic<bool>> is_cancelled_ = std::make_shared<std::atomic<bool>>(false);
+};
@@ -0,0 +1,292 @@
+#include "compressed_postings.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SEARCH_SERVER_X86_KERNELS
+#endif
+
+namespace {
+
+const size_t LANE_COUNT = 4;
+const size_t VALUES_PER_LANE = POSTING_BLOCK_SIZE / LANE_COUNT;
+
+unsigned BitWidth(uint32_t value) {
+    return value == 0 ? 0 : 32 - __builtin_clz(value);
+}
+
+uint32_t LowBitsMask(unsigned bits) {
+    return bits == 32 ? ~0u : (1u << bits) - 1;
+}
+
+//дописывает в data POSTING_BLOCK_SIZE значений по bits бит: bits * 4 слов, слово w дорожки l лежит в data[4 * w + l]
+void Pack(const uint32_t* values, unsigned bits, std::vector<uint32_t>& data) {
+    const size_t begin = data.size();
+    data.resize(begin + bits * LANE_COUNT);
+    uint32_t* words = data.data() + begin;
+    for (size_t j = 0; j < VALUES_PER_LANE && bits != 0; ++j) {
+        const size_t word = j * bits / 32;
+        const unsigned shift = j * bits % 32;
+        for (size_t lane = 0; lane < LANE_COUNT; ++lane) {
+            const uint32_t value = values[j * LANE_COUNT + lane];
+            words[word * LANE_COUNT + lane] |= value << shift;
+            if (shift + bits > 32) {
+                words[(word + 1) * LANE_COUNT + lane] |= value >> (32 - shift);
+            }
+        }
+    }
+}
+
+//неполный последний блок упаковывается подряд, без дорожек: иначе у редких слов хвост из нескольких постингов
+//занимал бы место целого блока
+void PackTail(const uint32_t* values, size_t count, unsigned bits, std::vector<uint32_t>& data) {
+    const size_t begin = data.size();
+    data.resize(begin + (count * bits + 31) / 32);
+    for (size_t i = 0; i < count && bits != 0; ++i) {
+        const size_t word = begin + i * bits / 32;
+        const unsigned shift = i * bits % 32;
+        data[word] |= values[i] << shift;
+        if (shift + bits > 32) {
+            data[word + 1] |= values[i] >> (32 - shift);
+        }
+    }
+}
+
+void UnpackTail(const uint32_t* words, size_t count, unsigned bits, uint32_t* values) {
+    const uint32_t mask = LowBitsMask(bits);
+    for (size_t i = 0; i < count; ++i) {
+        if (bits == 0) {
+            values[i] = 0;
+            continue;
+        }
+        const size_t word = i * bits / 32;
+        const unsigned shift = i * bits % 32;
+        uint32_t value = words[word] >> shift;
+        if (shift + bits > 32) {
+            value |= words[word + 1] << (32 - shift);
+        }
+        values[i] = value & mask;
+    }
+}
+
+//распаковка блока, упакованного Pack, и восстановление id из разностей: values[i] = base + сумма (values[k] + 1) по k <= i
+using UnpackKernel = void (*)(const uint32_t* words, unsigned bits, uint32_t* values);
+using PrefixSumKernel = void (*)(uint32_t base, uint32_t* values);
+
+void UnpackScalar(const uint32_t* words, unsigned bits, uint32_t* values) {
+    if (bits == 0) {
+        std::fill(values, values + POSTING_BLOCK_SIZE, 0);
+        return;
+    }
+    const uint32_t mask = LowBitsMask(bits);
+    for (size_t j = 0; j < VALUES_PER_LANE; ++j) {
+        const size_t word = j * bits / 32;
+        const unsigned shift = j * bits % 32;
+        for (size_t lane = 0; lane < LANE_COUNT; ++lane) {
+            uint32_t value = words[word * LANE_COUNT + lane] >> shift;
+            if (shift + bits > 32) {
+                value |= words[(word + 1) * LANE_COUNT + lane] << (32 - shift);
+            }
+            values[j * LANE_COUNT + lane] = value & mask;
+        }
+    }
+}
+
+void PrefixSumScalar(uint32_t base, uint32_t* values) {
+    for (size_t i = 0; i < POSTING_BLOCK_SIZE; ++i) {
+        base += values[i] + 1;
+        values[i] = base;
+    }
+}
+
+#ifdef SEARCH_SERVER_X86_KERNELS
+__attribute__((target("sse2")))
+void UnpackSse2(const uint32_t* words, unsigned bits, uint32_t* values) {
+    __m128i* out = reinterpret_cast<__m128i*>(values);
+    if (bits == 0) {
+        for (size_t j = 0; j < VALUES_PER_LANE; ++j) {
+            _mm_storeu_si128(out + j, _mm_setzero_si128());
+        }
+        return;
+    }
+    const __m128i* in = reinterpret_cast<const __m128i*>(words);
+    const __m128i mask = _mm_set1_epi32(static_cast<int>(LowBitsMask(bits)));
+    for (size_t j = 0; j < VALUES_PER_LANE; ++j) {
+        const size_t word = j * bits / 32;
+        const unsigned shift = j * bits % 32;
+        __m128i value = _mm_srl_epi32(_mm_loadu_si128(in + word), _mm_cvtsi32_si128(shift));
+        if (shift + bits > 32) {
+            value = _mm_or_si128(value, _mm_sll_epi32(_mm_loadu_si128(in + word + 1), _mm_cvtsi32_si128(32 - shift)));
+        }
+        _mm_storeu_si128(out + j, _mm_and_si128(value, mask));
+    }
+}
+
+//префиксная сумма внутри четвёрки - два сдвига со сложением, перенос из предыдущей четвёрки - её последний элемент
+__attribute__((target("sse2")))
+void PrefixSumSse2(uint32_t base, uint32_t* values) {
+    __m128i* data = reinterpret_cast<__m128i*>(values);
+    const __m128i one = _mm_set1_epi32(1);
+    __m128i carry = _mm_set1_epi32(static_cast<int>(base));
+    for (size_t j = 0; j < VALUES_PER_LANE; ++j) {
+        __m128i value = _mm_add_epi32(_mm_loadu_si128(data + j), one);
+        value = _mm_add_epi32(value, _mm_slli_si128(value, 4));
+        value = _mm_add_epi32(value, _mm_slli_si128(value, 8));
+        value = _mm_add_epi32(value, carry);
+        _mm_storeu_si128(data + j, value);
+        carry = _mm_shuffle_epi32(value, 0xFF);
+    }
+}
+#endif
+
+struct Kernels {
+    UnpackKernel unpack;
+    PrefixSumKernel prefix_sum;
+};
+
+//ядра выбираются один раз при первом вызове
+const Kernels& GetKernels() {
+    static const Kernels kernels = []() -> Kernels {
+#ifdef SEARCH_SERVER_X86_KERNELS
+        if (__builtin_cpu_supports("sse2")) {
+            return {UnpackSse2, PrefixSumSse2};
+        }
+#endif
+        return {UnpackScalar, PrefixSumScalar};
+    }();
+    return kernels;
+}
+
+} // namespace
+
+CompressedPostingList::CompressedPostingList(const std::vector<int>& document_ids, const std::vector<double>& term_freqs) {
+    for (const double term_freq : term_freqs) {
+        if (term_freq != 0.0) {
+            freq_table_.push_back(term_freq);
+        }
+    }
+    std::sort(freq_table_.begin(), freq_table_.end());
+    freq_table_.erase(std::unique(freq_table_.begin(), freq_table_.end()), freq_table_.end());
+    freq_bits_ = freq_table_.empty() ? 0 : BitWidth(freq_table_.size() - 1);
+    
+    std::array<uint32_t, POSTING_BLOCK_SIZE> deltas;
+    std::array<uint32_t, POSTING_BLOCK_SIZE> freq_codes;
+    int prev_id = -1;
+    size_t count = 0;
+    auto flush = [&]() {
+        uint32_t max_delta = 0;
+        for (size_t i = 0; i < count; ++i) {
+            max_delta = std::max(max_delta, deltas[i]);
+        }
+        const unsigned id_bits = BitWidth(max_delta);
+        blocks_.push_back({prev_id, static_cast<uint32_t>(data_.size()), static_cast<uint8_t>(id_bits)});
+        if (count == POSTING_BLOCK_SIZE) {
+            Pack(deltas.data(), id_bits, data_);
+            Pack(freq_codes.data(), freq_bits_, data_);
+        } else {
+            PackTail(deltas.data(), count, id_bits, data_);
+            PackTail(freq_codes.data(), count, freq_bits_, data_);
+        }
+        count = 0;
+    };
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        if (term_freqs[i] == 0.0) {
+            continue;
+        }
+        deltas[count] = static_cast<uint32_t>(document_ids[i]) - static_cast<uint32_t>(prev_id) - 1;
+        freq_codes[count] = std::lower_bound(freq_table_.begin(), freq_table_.end(), term_freqs[i]) - freq_table_.begin();
+        prev_id = document_ids[i];
+        ++size_;
+        if (++count == POSTING_BLOCK_SIZE) {
+            flush();
+        }
+    }
+    if (count != 0) {
+        flush();
+    }
+    
+    blocks_.shrink_to_fit();
+    data_.shrink_to_fit();
+}
+
+size_t CompressedPostingList::GetMemoryUsage() const {
+    return blocks_.size() * sizeof(BlockHeader) + data_.size() * sizeof(uint32_t) + freq_table_.size() * sizeof(double);
+}
+
+bool CompressedPostingList::Contains(int document_id) const {
+    const auto it = std::lower_bound(blocks_.begin(), blocks_.end(), document_id, [](const BlockHeader& block, int id) {
+        return block.last_id < id;
+    });
+    if (it == blocks_.end()) {
+        return false;
+    }
+    //частоты для проверки не нужны, распаковываются только id
+    Block block;
+    DecodeIds(it - blocks_.begin(), block);
+    return std::binary_search(block.document_ids.begin(), block.document_ids.begin() + block.size, document_id);
+}
+
+void CompressedPostingList::DecodeBlock(size_t block_index, Block& block) const {
+    DecodeIds(block_index, block);
+    const BlockHeader& header = blocks_[block_index];
+    if (block.size == POSTING_BLOCK_SIZE) {
+        GetKernels().unpack(data_.data() + header.offset + header.id_bits * LANE_COUNT, freq_bits_, block.freq_codes.data());
+    } else {
+        const size_t id_words = (block.size * header.id_bits + 31) / 32;
+        UnpackTail(data_.data() + header.offset + id_words, block.size, freq_bits_, block.freq_codes.data());
+    }
+}
+
+void CompressedPostingList::DecodeIds(size_t block_index, Block& block) const {
+    const BlockHeader& header = blocks_[block_index];
+    uint32_t base = static_cast<uint32_t>(block_index == 0 ? -1 : blocks_[block_index - 1].last_id);
+    uint32_t* document_ids = reinterpret_cast<uint32_t*>(block.document_ids.data());
+    block.size = block_index + 1 < blocks_.size() ? POSTING_BLOCK_SIZE : size_ - block_index * POSTING_BLOCK_SIZE;
+    if (block.size == POSTING_BLOCK_SIZE) {
+        const Kernels& kernels = GetKernels();
+        kernels.unpack(data_.data() + header.offset, header.id_bits, document_ids);
+        kernels.prefix_sum(base, document_ids);
+        return;
+    }
+    UnpackTail(data_.data() + header.offset, block.size, header.id_bits, document_ids);
+    for (size_t i = 0; i < block.size; ++i) {
+        base += document_ids[i] + 1;
+        document_ids[i] = base;
+    }
+}
+
+CompressedPostingList::Cursor::Cursor(const CompressedPostingList& posting_list) : posting_list_(&posting_list) {
+    LoadBlock(0);
+}
+
+void CompressedPostingList::Cursor::Next() {
+    if (++pos_ == block_.size) {
+        LoadBlock(block_index_ + 1);
+    }
+}
+
+void CompressedPostingList::Cursor::SeekTo(int document_id) {
+    if (IsExhausted() || CurrentId() >= document_id) {
+        return;
+    }
+    const auto& blocks = posting_list_->blocks_;
+    if (blocks[block_index_].last_id < document_id) {
+        const auto it = std::lower_bound(blocks.begin() + block_index_ + 1, blocks.end(), document_id, [](const BlockHeader& block, int id) {
+            return block.last_id < id;
+        });
+        LoadBlock(it - blocks.begin());
+        if (IsExhausted()) {
+            return;
+        }
+    }
+    pos_ = std::lower_bound(block_.document_ids.begin() + pos_, block_.document_ids.begin() + block_.size, document_id) - block_.document_ids.begin();
+}
+
+void CompressedPostingList::Cursor::LoadBlock(size_t block_index) {
+    block_index_ = block_index;
+    pos_ = 0;
+    if (!IsExhausted()) {
+        posting_list_->DecodeBlock(block_index, block_);
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+const size_t POSTING_BLOCK_SIZE = 128;
+
+//Неизменяемый сжатый список постингов. Постинги разбиты на блоки по POSTING_BLOCK_SIZE. В блоке хранятся разности соседних id
+//минус один, упакованные минимальным для блока числом бит, и номера частот в словаре различных частот списка, упакованные так же.
+//Упаковка полного блока вертикальная: значение i лежит в 32-битной дорожке i % 4, поэтому он распаковывается векторно, по четыре значения.
+//Заголовок блока хранит последний id и смещение данных: поиск id распаковывает только один блок
+class CompressedPostingList {
+public:
+    //распакованный блок; в последнем блоке списка значений может быть меньше POSTING_BLOCK_SIZE
+    struct Block {
+        std::array<int32_t, POSTING_BLOCK_SIZE> document_ids;
+        std::array<uint32_t, POSTING_BLOCK_SIZE> freq_codes;
+        size_t size = 0;
+    };
+    
+    //постинги читаются по возрастанию id, постинги с нулевой частотой (пометки удаления) пропускаются
+    class Cursor {
+    public:
+        explicit Cursor(const CompressedPostingList& posting_list);
+        
+        bool IsExhausted() const { return block_index_ == posting_list_->blocks_.size(); }
+        int CurrentId() const { return block_.document_ids[pos_]; }
+        double CurrentTermFreq() const { return posting_list_->freq_table_[block_.freq_codes[pos_]]; }
+        void Next();
+        //переходит к первому постингу с id не меньше document_id; блоки, целиком лежащие левее, не распаковываются
+        void SeekTo(int document_id);
+    
+    private:
+        void LoadBlock(size_t block_index);
+        
+        const CompressedPostingList* posting_list_;
+        size_t block_index_ = 0;
+        size_t pos_ = 0;
+        Block block_;
+    };
+    
+    CompressedPostingList() = default;
+    CompressedPostingList(const std::vector<int>& document_ids, const std::vector<double>& term_freqs);
+    
+    size_t size() const { return size_; }
+    //байты, занятые постингами, без учёта самого объекта
+    size_t GetMemoryUsage() const;
+    bool Contains(int document_id) const;
+    void DecodeBlock(size_t block_index, Block& block) const;
+    
+    template <typename Function>
+    void ForEach(Function function) const {
+        ForEachUntil(function, []() {
+            return false;
+        });
+    }
+    //то же, но перед каждым блоком спрашивает is_stopped() и, если тот вернул true, обход прекращается
+    template <typename Function, typename StopPredicate>
+    void ForEachUntil(Function function, StopPredicate is_stopped) const {
+        Block block;
+        for (size_t i = 0; i < blocks_.size(); ++i) {
+            if (is_stopped()) {
+                return;
+            }
+            DecodeBlock(i, block);
+            for (size_t j = 0; j < block.size; ++j) {
+                function(block.document_ids[j], freq_table_[block.freq_codes[j]]);
+            }
+        }
+    }
+
+private:
+    struct BlockHeader {
+        int32_t last_id;
+        uint32_t offset; //начало данных блока в data_: сначала id_bits * 4 слов id, затем freq_bits_ * 4 слов частот
+        uint8_t id_bits;
+    };
+    
+    void DecodeIds(size_t block_index, Block& block) const;
+    
+    std::vector<BlockHeader> blocks_;
+    std::vector<uint32_t> data_;
+    std::vector<double> freq_table_; //различные частоты списка по возрастанию
+    uint8_t freq_bits_ = 0;
+    size_t size_ = 0;
+};
@@ -20,7 +20,7 @@ std::ostream& operator<<(std::ostream& os, const DocumentStatus& status) {
     return os;
 }
 
-void PrintMatchDocumentResult(int id, const std::vector<std::string>& words, DocumentStatus status) {
+void PrintMatchDocumentResult(int id, const std::vector<std::string_view>& words, DocumentStatus status) {
     using namespace std;
     
     cout << "{ "s
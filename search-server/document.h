@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 enum class DocumentStatus {
@@ -12,7 +13,7 @@ enum class DocumentStatus {
 };
 
 std::ostream& operator<<(std::ostream& out, const DocumentStatus& status);
-void PrintMatchDocumentResult(int id, const std::vector<std::string>& words, DocumentStatus status);
+void PrintMatchDocumentResult(int id, const std::vector<std::string_view>& words, DocumentStatus status);
 
 struct Document {
     int id = 0;
@@ -0,0 +1,88 @@
+#include "document_bitmap.h"
+
+void DocumentBitmap::Add(int document_id) {
+    const uint32_t id = static_cast<uint32_t>(document_id);
+    const uint16_t key = id >> 16;
+    const uint16_t value = id & 0xFFFF;
+    
+    //id обычно добавляются по возрастанию, тогда нужный контейнер - последний
+    auto it = containers_.end();
+    if (containers_.empty() || containers_.back().key < key) {
+        it = containers_.insert(containers_.end(), Container{key, {}, {}, 0});
+    } else if (containers_.back().key != key) {
+        it = std::lower_bound(containers_.begin(), containers_.end(), key, [](const Container& container, uint16_t key) {
+            return container.key < key;
+        });
+        if (it->key != key) {
+            it = containers_.insert(it, Container{key, {}, {}, 0});
+        }
+    } else {
+        --it;
+    }
+    
+    Container& container = *it;
+    if (!container.bits.empty()) {
+        uint64_t& word = container.bits[value >> 6];
+        const uint64_t bit = uint64_t{1} << (value & 63);
+        container.count += (word & bit) == 0;
+        word |= bit;
+        return;
+    }
+    
+    auto pos = container.values.end();
+    if (!container.values.empty() && container.values.back() >= value) {
+        pos = std::lower_bound(container.values.begin(), container.values.end(), value);
+        if (*pos == value) {
+            return;
+        }
+    }
+    container.values.insert(pos, value);
+    ++container.count;
+    
+    if (container.count > BITMAP_ARRAY_CONTAINER_LIMIT) {
+        container.bits.assign(65536 / 64, 0);
+        for (const uint16_t v : container.values) {
+            container.bits[v >> 6] |= uint64_t{1} << (v & 63);
+        }
+        container.values = std::vector<uint16_t>();
+    }
+}
+
+void DocumentBitmap::Remove(int document_id) {
+    const uint32_t id = static_cast<uint32_t>(document_id);
+    const uint16_t value = id & 0xFFFF;
+    const auto it = std::lower_bound(containers_.begin(), containers_.end(), id >> 16, [](const Container& container, uint32_t key) {
+        return container.key < key;
+    });
+    if (it == containers_.end() || it->key != id >> 16 || !it->Contains(value)) {
+        return;
+    }
+    
+    Container& container = *it;
+    --container.count;
+    if (container.count == 0) {
+        containers_.erase(it);
+        return;
+    }
+    if (container.bits.empty()) {
+        container.values.erase(std::lower_bound(container.values.begin(), container.values.end(), value));
+        return;
+    }
+    container.bits[value >> 6] &= ~(uint64_t{1} << (value & 63));
+    if (container.count <= BITMAP_ARRAY_CONTAINER_LIMIT) {
+        for (size_t i = 0; i < container.bits.size(); ++i) {
+            for (uint64_t word = container.bits[i]; word != 0; word &= word - 1) {
+                container.values.push_back(static_cast<uint16_t>(i * 64 + __builtin_ctzll(word)));
+            }
+        }
+        container.bits = std::vector<uint64_t>();
+    }
+}
+
+size_t DocumentBitmap::size() const {
+    size_t count = 0;
+    for (const Container& container : containers_) {
+        count += container.count;
+    }
+    return count;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+const size_t BITMAP_ARRAY_CONTAINER_LIMIT = 4096; //столько младших половин занимают в массиве столько же, сколько плотный битсет
+
+//Множество id документов по образцу roaring bitmap. Id делится на старшие и младшие 16 бит; для каждого старшего значения
+//заводится контейнер - отсортированный массив младших половин, пока их не больше BITMAP_ARRAY_CONTAINER_LIMIT,
+//и плотный битсет на 65536 бит, когда их больше. Так разреженные и плотные диапазоны id занимают мало места и проверяются быстро
+class DocumentBitmap {
+public:
+    void Add(int document_id);
+    void Remove(int document_id);
+    
+    bool Contains(int document_id) const {
+        const uint32_t id = static_cast<uint32_t>(document_id);
+        const Container* container = FindContainer(id >> 16);
+        return container && container->Contains(id & 0xFFFF);
+    }
+    size_t size() const;
+
+private:
+    struct Container {
+        uint16_t key;
+        std::vector<uint16_t> values; //младшие половины по возрастанию, пока контейнер разреженный
+        std::vector<uint64_t> bits;   //1024 слова, когда контейнер плотный; values тогда пуст
+        size_t count = 0;
+        
+        bool Contains(uint16_t value) const {
+            if (!bits.empty()) {
+                return bits[value >> 6] >> (value & 63) & 1;
+            }
+            return std::binary_search(values.begin(), values.end(), value);
+        }
+    };
+    
+    const Container* FindContainer(uint32_t key) const {
+        const auto it = std::lower_bound(containers_.begin(), containers_.end(), key, [](const Container& container, uint32_t key) {
+            return container.key < key;
+        });
+        return it != containers_.end() && it->key == key ? &*it : nullptr;
+    }
+    
+    std::vector<Container> containers_; //по возрастанию key
+};
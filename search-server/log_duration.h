@@ -3,25 +3,51 @@
 #include <chrono>
 #include <iostream>
 #include <string>
+#include <string_view>
+#include <type_traits>
 
 #define PROFILE_CONCAT_INTERNAL(X, Y) X ## Y
 #define PROFILE_CONCAT(X, Y) PROFILE_CONCAT_INTERNAL(X, Y)
 #define UNIQUE_VAR_NAME_PROFILE PROFILE_CONCAT(profileGuard, __LINE__)
 #define LOG_DURATION(x) LogDuration UNIQUE_VAR_NAME_PROFILE(x)
+#define LOG_DURATION_STREAM(x, y) LogDuration UNIQUE_VAR_NAME_PROFILE(x, y)
+#define LOG_DURATION_US(x) LogDurationUs UNIQUE_VAR_NAME_PROFILE(x)
+#define LOG_DURATION_NS(x) LogDurationNs UNIQUE_VAR_NAME_PROFILE(x)
 
-class LogDuration {
+//Resolution - единица, в которой печатается время: std::chrono::milliseconds, microseconds или nanoseconds
+template <typename Resolution>
+class BasicLogDuration {
 public:
     using Clock = std::chrono::steady_clock;
     
-    LogDuration(const std::string& msg) : msg_(msg) {}
+    BasicLogDuration(std::string_view msg, std::ostream& out = std::cerr) : msg_(msg), out_(out) {}
     
-    ~LogDuration() {
+    ~BasicLogDuration() {
         using namespace std::chrono;
         using namespace std::literals;
         
-        std::cerr << msg_ << ": "s << duration_cast<milliseconds>(Clock::now() - start_time_).count() << " ms"s << std::endl;
+        out_ << msg_ << ": "s << duration_cast<Resolution>(Clock::now() - start_time_).count() << ' ' << UnitName() << std::endl;
     }
 private:
+    static std::string_view UnitName() {
+        using namespace std::literals;
+        
+        if constexpr (std::is_same_v<Resolution, std::chrono::nanoseconds>) {
+            return "ns"sv;
+        } else if constexpr (std::is_same_v<Resolution, std::chrono::microseconds>) {
+            return "us"sv;
+        } else if constexpr (std::is_same_v<Resolution, std::chrono::milliseconds>) {
+            return "ms"sv;
+        } else {
+            return "s"sv;
+        }
+    }
+    
     const Clock::time_point start_time_ = Clock::now();
     const std::string msg_;
+    std::ostream& out_;
 };
+
+using LogDuration = BasicLogDuration<std::chrono::milliseconds>;
+using LogDurationUs = BasicLogDuration<std::chrono::microseconds>;
+using LogDurationNs = BasicLogDuration<std::chrono::nanoseconds>;
@@ -3,11 +3,14 @@
 #include "request_queue.h"
 //#include "search_server.h"
 
+#include <thread>
+
 int main() {
     using namespace std;
     
     SearchServer search_server("and in at"s);
-    RequestQueue request_queue(search_server);
+    // окно статистики - 2 секунды реального времени, чтобы было видно, как оно сдвигается
+    RequestQueue request_queue(search_server, chrono::seconds(2));
     search_server.AddDocument(1, "curly cat curly tail"s, DocumentStatus::ACTUAL, {7, 2, 7});
     search_server.AddDocument(2, "curly dog and fancy collar"s, DocumentStatus::ACTUAL, {1, 2, 3});
     search_server.AddDocument(3, "big cat fancy collar "s, DocumentStatus::ACTUAL, {1, 2, 8});
@@ -17,12 +20,15 @@ int main() {
     for (int i = 0; i < 1439; ++i) {
         request_queue.AddFindRequest("empty request"s);
     }
-    // все еще 1439 запросов с нулевым результатом
+    cout << "Total empty requests: "s << request_queue.GetNoResultRequests() << endl;
+    // окно сдвинулось, прежние запросы из него вышли; в нём только три запроса с результатом
+    this_thread::sleep_for(chrono::seconds(2));
     request_queue.AddFindRequest("curly dog"s);
-    // новые сутки, первый запрос удален, 1438 запросов с нулевым результатом
     request_queue.AddFindRequest("big collar"s);
-    // первый запрос удален, 1437 запросов с нулевым результатом
     request_queue.AddFindRequest("sparrow"s);
     cout << "Total empty requests: "s << request_queue.GetNoResultRequests() << endl;
+    
+    const RequestStats stats = request_queue.GetStats();
+    cout << "Total requests: "s << stats.requests << ", p50 < "s << stats.p50.count() << " us, p99 < "s << stats.p99.count() << " us"s << endl;
     return 0;
 }
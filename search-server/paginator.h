@@ -2,28 +2,20 @@
 
 #include "document.h"
 
+#include <algorithm>
+#include <cstddef>
 #include <iostream>
-#include <vector>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
 
+//Страницы не хранятся, а вычисляются по мере обхода: граница следующей страницы ищется, только когда до неё дошли.
+//Достаточно прямого итератора - диапазон проходится по одному разу при обходе страниц и при выводе каждой
 template <typename Iterator>
 class Paginator {
-public:
-    Paginator(Iterator begin, Iterator end, size_t page_size) {
-        size_t docs_left = distance(begin, end);
-        while (docs_left) {
-            size_t docs_per_current_page = std::min(page_size, docs_left);
-            pages_.emplace_back(begin, begin + docs_per_current_page);
-            
-            begin += docs_per_current_page;
-            docs_left -= docs_per_current_page;
-        }
-    }
+    static_assert(std::is_base_of_v<std::forward_iterator_tag, typename std::iterator_traits<Iterator>::iterator_category>,
+                  "page boundaries are re-read, so Paginator needs at least a forward iterator");
     
-    auto begin() const { return pages_.begin(); }
-    auto end() const { return pages_.end(); }
-    bool empty() const { return pages_.empty(); }
-    size_t size()  const { return pages_.size(); }
-private:
     struct IteratorRange {
         Iterator begin;
         Iterator end;
@@ -37,8 +29,71 @@ private:
             return os;
         }
     };
+
+public:
+    class PageIterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = IteratorRange;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const IteratorRange*;
+        using reference = const IteratorRange&;
+        
+        PageIterator(Iterator begin, Iterator end, size_t page_size)
+            : page_(begin, Advance(begin, end, page_size)), end_(end), page_size_(page_size) {}
+        
+        reference operator*() const { return page_; }
+        pointer operator->() const { return &page_; }
+        
+        PageIterator& operator++() {
+            page_ = IteratorRange(page_.end, Advance(page_.end, end_, page_size_));
+            return *this;
+        }
+        PageIterator operator++(int) {
+            PageIterator result = *this;
+            ++*this;
+            return result;
+        }
+        
+        bool operator==(const PageIterator& other) const { return page_.begin == other.page_.begin; }
+        bool operator!=(const PageIterator& other) const { return !(*this == other); }
     
-    std::vector<IteratorRange> pages_;
+    private:
+        static Iterator Advance(Iterator it, Iterator end, size_t count) {
+            if constexpr (std::is_base_of_v<std::random_access_iterator_tag, typename std::iterator_traits<Iterator>::iterator_category>) {
+                return it + std::min<std::ptrdiff_t>(count, end - it);
+            } else {
+                for (; count != 0 && it != end; --count) {
+                    ++it;
+                }
+                return it;
+            }
+        }
+        
+        IteratorRange page_;
+        Iterator end_;
+        size_t page_size_;
+    };
+    
+    Paginator(Iterator begin, Iterator end, size_t page_size) : begin_(begin), end_(end), page_size_(page_size) {
+        if (page_size == 0) {
+            throw std::invalid_argument("page size must be positive");
+        }
+    }
+    
+    PageIterator begin() const { return PageIterator(begin_, end_, page_size_); }
+    PageIterator end() const { return PageIterator(end_, end_, page_size_); }
+    bool empty() const { return begin_ == end_; }
+    //для итераторов без произвольного доступа проходит весь диапазон
+    size_t size() const {
+        const size_t count = std::distance(begin_, end_);
+        return (count + page_size_ - 1) / page_size_;
+    }
+
+private:
+    Iterator begin_;
+    Iterator end_;
+    size_t page_size_;
 };
 
 template <typename Container>
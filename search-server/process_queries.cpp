@@ -0,0 +1,18 @@
+#include "process_queries.h"
+
+#include <algorithm>
+#include <execution>
+
+std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries) {
+    //параллельный transform раздаёт запросы планировщику с перехватом задач, поэтому тяжёлые запросы не задерживают остальные;
+    //результат пишется по индексу запроса, так что порядок совпадает с входным
+    std::vector<std::vector<Document>> documents_lists(queries.size());
+    std::transform(std::execution::par, queries.begin(), queries.end(), documents_lists.begin(), [&](const std::string& query) {
+        return search_server.FindTopDocuments(query);
+    });
+    return documents_lists;
+}
+
+JoinedDocuments ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries) {
+    return JoinedDocuments(ProcessQueries(search_server, queries));
+}
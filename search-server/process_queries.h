@@ -0,0 +1,66 @@
+#pragma once
+
+#include "document.h"
+#include "search_server.h"
+
+#include <iterator>
+#include <string>
+#include <vector>
+
+//результаты пакета запросов одной последовательностью документов; вложенные векторы не копируются в общий
+class JoinedDocuments {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Document;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Document*;
+        using reference = const Document&;
+        
+        Iterator(std::vector<std::vector<Document>>::const_iterator outer, std::vector<std::vector<Document>>::const_iterator outer_end)
+            : outer_(outer), outer_end_(outer_end) {
+            SkipEmpty();
+        }
+        
+        reference operator*() const { return (*outer_)[inner_]; }
+        pointer operator->() const { return &(*outer_)[inner_]; }
+        
+        Iterator& operator++() {
+            ++inner_;
+            SkipEmpty();
+            return *this;
+        }
+        Iterator operator++(int) {
+            Iterator old = *this;
+            ++*this;
+            return old;
+        }
+        
+        bool operator==(const Iterator& other) const { return outer_ == other.outer_ && inner_ == other.inner_; }
+        bool operator!=(const Iterator& other) const { return !(*this == other); }
+        
+    private:
+        void SkipEmpty() {
+            while (outer_ != outer_end_ && inner_ == outer_->size()) {
+                ++outer_;
+                inner_ = 0;
+            }
+        }
+        
+        std::vector<std::vector<Document>>::const_iterator outer_;
+        std::vector<std::vector<Document>>::const_iterator outer_end_;
+        size_t inner_ = 0;
+    };
+    
+    explicit JoinedDocuments(std::vector<std::vector<Document>> documents_lists) : documents_lists_(std::move(documents_lists)) {}
+    
+    Iterator begin() const { return Iterator(documents_lists_.begin(), documents_lists_.end()); }
+    Iterator end() const { return Iterator(documents_lists_.end(), documents_lists_.end()); }
+    
+private:
+    std::vector<std::vector<Document>> documents_lists_;
+};
+
+std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries);
+JoinedDocuments ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries);
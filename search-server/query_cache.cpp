@@ -0,0 +1,68 @@
+#include "query_cache.h"
+
+#include <algorithm>
+#include <functional>
+
+const size_t QUERY_CACHE_BUCKET_COUNT = 16;
+
+QueryCache::QueryCache(size_t capacity) : buckets_(std::clamp<size_t>(capacity, 1, QUERY_CACHE_BUCKET_COUNT)) {
+    //ёмкость делится между корзинами, остаток достаётся первым
+    for (size_t i = 0; i < buckets_.size(); ++i) {
+        buckets_[i].capacity = capacity / buckets_.size() + (i < capacity % buckets_.size() ? 1 : 0);
+    }
+}
+
+std::optional<std::vector<Document>> QueryCache::Find(const std::string& key, uint64_t epoch) {
+    Bucket& bucket = GetBucket(key);
+    std::lock_guard guard(bucket.mutex);
+    
+    const auto it = bucket.index.find(key);
+    if (it == bucket.index.end()) {
+        ++misses_;
+        return std::nullopt;
+    }
+    if (it->second->epoch != epoch) {
+        bucket.entries.erase(it->second);
+        bucket.index.erase(it);
+        ++misses_;
+        return std::nullopt;
+    }
+    
+    bucket.entries.splice(bucket.entries.begin(), bucket.entries, it->second);
+    ++hits_;
+    return it->second->documents;
+}
+
+void QueryCache::Insert(const std::string& key, uint64_t epoch, const std::vector<Document>& documents) {
+    Bucket& bucket = GetBucket(key);
+    if (bucket.capacity == 0) {
+        return;
+    }
+    std::lock_guard guard(bucket.mutex);
+    
+    const auto it = bucket.index.find(key);
+    if (it != bucket.index.end()) {
+        //запрос могли посчитать параллельно в двух потоках; оставляем запись более новой эпохи
+        if (it->second->epoch <= epoch) {
+            it->second->epoch = epoch;
+            it->second->documents = documents;
+        }
+        bucket.entries.splice(bucket.entries.begin(), bucket.entries, it->second);
+        return;
+    }
+    
+    if (bucket.entries.size() == bucket.capacity) {
+        bucket.index.erase(bucket.entries.back().key);
+        bucket.entries.pop_back();
+    }
+    bucket.entries.push_front({key, epoch, documents});
+    bucket.index.emplace(key, bucket.entries.begin());
+}
+
+QueryCacheStats QueryCache::GetStats() const {
+    return {hits_, misses_};
+}
+
+QueryCache::Bucket& QueryCache::GetBucket(const std::string& key) {
+    return buckets_[std::hash<std::string>{}(key) % buckets_.size()];
+}
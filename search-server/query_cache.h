@@ -0,0 +1,48 @@
+#pragma once
+
+#include "document.h"
+
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct QueryCacheStats {
+    size_t hits = 0;
+    size_t misses = 0;
+};
+
+//LRU-кэш результатов запросов, разбитый на корзины со своими мьютексами, как ConcurrentMap.
+//Каждая запись помнит эпоху индекса, на которой посчитана; запись из другой эпохи не отдаётся и удаляется
+class QueryCache {
+public:
+    explicit QueryCache(size_t capacity);
+    
+    std::optional<std::vector<Document>> Find(const std::string& key, uint64_t epoch);
+    void Insert(const std::string& key, uint64_t epoch, const std::vector<Document>& documents);
+    
+    QueryCacheStats GetStats() const;
+
+private:
+    struct Entry {
+        std::string key;
+        uint64_t epoch;
+        std::vector<Document> documents;
+    };
+    
+    struct Bucket {
+        std::mutex mutex;
+        std::list<Entry> entries; //в начале - недавно использованные
+        std::unordered_map<std::string, std::list<Entry>::iterator> index;
+        size_t capacity = 0;
+    };
+    
+    Bucket& GetBucket(const std::string& key);
+    
+    std::vector<Bucket> buckets_;
+    std::atomic<size_t> hits_{0};
+    std::atomic<size_t> misses_{0};
+};
@@ -0,0 +1,62 @@
+#include "query_stats.h"
+
+#include <algorithm>
+
+namespace {
+
+const char* const QUERY_PHASE_NAMES[] = {"parse", "scoring", "minus_filter", "sort"};
+
+void WriteCounter(std::ostream& out, const char* name, const char* help, uint64_t value) {
+    out << "# HELP " << name << ' ' << help << '\n';
+    out << "# TYPE " << name << " counter\n";
+    out << name << ' ' << value << '\n';
+}
+
+} // namespace
+
+void QueryMetrics::Histogram::Observe(std::chrono::nanoseconds duration) {
+    const size_t bucket = std::lower_bound(QUERY_PHASE_BUCKET_BOUNDS.begin(), QUERY_PHASE_BUCKET_BOUNDS.end(), duration.count())
+                        - QUERY_PHASE_BUCKET_BOUNDS.begin();
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    sum_ns.fetch_add(duration.count(), std::memory_order_relaxed);
+}
+
+void QueryMetrics::Record(const QueryStats& stats) {
+    queries_.fetch_add(1, std::memory_order_relaxed);
+    postings_scanned_.fetch_add(stats.postings_scanned, std::memory_order_relaxed);
+    predicate_rejections_.fetch_add(stats.predicate_rejections, std::memory_order_relaxed);
+    results_.fetch_add(stats.result_count, std::memory_order_relaxed);
+    
+    phases_[0].Observe(stats.parse_time);
+    phases_[1].Observe(stats.scoring_time);
+    phases_[2].Observe(stats.minus_filter_time);
+    phases_[3].Observe(stats.sort_time);
+}
+
+void QueryMetrics::WritePrometheus(std::ostream& out) const {
+    WriteCounter(out, "search_server_queries_total", "Queries executed with statistics enabled.", queries_);
+    WriteCounter(out, "search_server_postings_scanned_total", "Postings read while answering queries.", postings_scanned_);
+    WriteCounter(out, "search_server_predicate_rejections_total", "Documents rejected by the query predicate.", predicate_rejections_);
+    WriteCounter(out, "search_server_results_total", "Documents returned by queries.", results_);
+    
+    //корзины хранятся по отдельности, а Prometheus ждёт накопленные суммы
+    out << "# HELP search_server_query_phase_seconds Time spent in each query phase.\n";
+    out << "# TYPE search_server_query_phase_seconds histogram\n";
+    for (size_t phase = 0; phase < phases_.size(); ++phase) {
+        const Histogram& histogram = phases_[phase];
+        const char* name = QUERY_PHASE_NAMES[phase];
+        uint64_t count = 0;
+        for (size_t i = 0; i < histogram.buckets.size(); ++i) {
+            count += histogram.buckets[i].load(std::memory_order_relaxed);
+            out << "search_server_query_phase_seconds_bucket{phase=\"" << name << "\",le=\"";
+            if (i < QUERY_PHASE_BUCKET_BOUNDS.size()) {
+                out << QUERY_PHASE_BUCKET_BOUNDS[i] / 1e9;
+            } else {
+                out << "+Inf";
+            }
+            out << "\"} " << count << '\n';
+        }
+        out << "search_server_query_phase_seconds_sum{phase=\"" << name << "\"} " << histogram.sum_ns.load(std::memory_order_relaxed) / 1e9 << '\n';
+        out << "search_server_query_phase_seconds_count{phase=\"" << name << "\"} " << count << '\n';
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+//Статистика одного запроса. Фазы не пересекаются: время отсева минус-словами не входит во время подсчёта релевантности
+struct QueryStats {
+    static constexpr bool enabled = true;
+    
+    std::chrono::nanoseconds parse_time{0};
+    std::chrono::nanoseconds scoring_time{0};
+    std::chrono::nanoseconds minus_filter_time{0};
+    std::chrono::nanoseconds sort_time{0};
+    uint64_t postings_scanned = 0;
+    uint64_t predicate_rejections = 0; //сколько документов отверг предикат; документ с несколькими словами запроса считается один раз
+    uint64_t result_count = 0;
+};
+
+//подставляется в шаблоны поиска, когда статистика не нужна: все замеры и счётчики исчезают при компиляции
+struct NoQueryStats {
+    static constexpr bool enabled = false;
+};
+
+//замеряет время фазы от создания до разрушения и прибавляет его к полю phase статистики
+template <typename Stats>
+class QueryPhaseTimer {
+public:
+    QueryPhaseTimer(Stats&, std::chrono::nanoseconds QueryStats::*) {}
+};
+
+template <>
+class QueryPhaseTimer<QueryStats> {
+public:
+    using Clock = std::chrono::steady_clock;
+    
+    QueryPhaseTimer(QueryStats& stats, std::chrono::nanoseconds QueryStats::* phase) : phase_time_(stats.*phase) {}
+    ~QueryPhaseTimer() {
+        phase_time_ += Clock::now() - start_;
+    }
+
+private:
+    std::chrono::nanoseconds& phase_time_;
+    const Clock::time_point start_ = Clock::now();
+};
+
+//границы корзин гистограммы длительности фаз, в наносекундах
+const std::array<int64_t, 12> QUERY_PHASE_BUCKET_BOUNDS = {
+    1'000, 5'000, 10'000, 50'000, 100'000, 500'000, 1'000'000, 5'000'000, 10'000'000, 50'000'000, 100'000'000, 1'000'000'000};
+
+//Сводные счётчики и гистограммы по всем запросам со статистикой. Запись - только атомарные инкременты
+class QueryMetrics {
+public:
+    void Record(const QueryStats& stats);
+    //текстовый формат экспорта Prometheus
+    void WritePrometheus(std::ostream& out) const;
+
+private:
+    struct Histogram {
+        std::array<std::atomic<uint64_t>, QUERY_PHASE_BUCKET_BOUNDS.size() + 1> buckets{}; //последняя - +Inf
+        std::atomic<uint64_t> sum_ns{0};
+        
+        void Observe(std::chrono::nanoseconds duration);
+    };
+    
+    std::atomic<uint64_t> queries_{0};
+    std::atomic<uint64_t> postings_scanned_{0};
+    std::atomic<uint64_t> predicate_rejections_{0};
+    std::atomic<uint64_t> results_{0};
+    std::array<Histogram, 4> phases_; //parse, scoring, minus_filter, sort
+};
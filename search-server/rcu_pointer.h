@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+const size_t RCU_READER_SLOT_COUNT = 64;
+
+//Указатель на неизменяемое значение, которое читают без блокировок и изредка подменяют целиком (RCU).
+//Читатель отмечается в счётчике своей ячейки для текущего поколения. Писатель подменяет значение, переключает поколение
+//и ждёт, пока разойдутся читатели прежнего поколения, - только после этого старое значение удаляется.
+//Писателей сериализует вызывающий; поток, держащий ReadGuard, не должен вызывать Publish - он будет ждать сам себя
+template <typename T>
+class RcuPointer {
+public:
+    class ReadGuard {
+    public:
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+        ~ReadGuard() {
+            readers_.fetch_sub(1);
+        }
+        
+        const T& operator*() const { return *value_; }
+        const T* operator->() const { return value_; }
+    
+    private:
+        friend class RcuPointer;
+        ReadGuard(std::atomic<uint64_t>& readers, const T* value) : readers_(readers), value_(value) {}
+        
+        std::atomic<uint64_t>& readers_;
+        const T* value_;
+    };
+    
+    explicit RcuPointer(std::unique_ptr<const T> value) : value_(value.release()) {}
+    ~RcuPointer() {
+        delete value_.load();
+    }
+    
+    RcuPointer(const RcuPointer&) = delete;
+    RcuPointer& operator=(const RcuPointer&) = delete;
+    
+    ReadGuard Read() const {
+        Slot& slot = slots_[GetSlotIndex()];
+        while (true) {
+            //если писатель переключил поколение между чтением номера и отметкой, отметка переносится в новое
+            const uint64_t generation = generation_.load();
+            std::atomic<uint64_t>& readers = slot.readers[generation % 2];
+            readers.fetch_add(1);
+            if (generation_.load() == generation) {
+                return ReadGuard(readers, value_.load());
+            }
+            readers.fetch_sub(1);
+        }
+    }
+    
+    void Publish(std::unique_ptr<const T> value) {
+        const T* old_value = value_.exchange(value.release());
+        const uint64_t generation = generation_.load();
+        generation_.store(generation + 1);
+        for (const Slot& slot : slots_) {
+            while (slot.readers[generation % 2].load() != 0) {
+                std::this_thread::yield();
+            }
+        }
+        delete old_value;
+    }
+
+private:
+    struct alignas(64) Slot {
+        std::array<std::atomic<uint64_t>, 2> readers{};
+    };
+    
+    static size_t GetSlotIndex() {
+        static std::atomic<size_t> next_slot{0};
+        thread_local const size_t slot = next_slot++ % RCU_READER_SLOT_COUNT;
+        return slot;
+    }
+    
+    std::atomic<const T*> value_;
+    std::atomic<uint64_t> generation_{0};
+    mutable std::array<Slot, RCU_READER_SLOT_COUNT> slots_;
+};
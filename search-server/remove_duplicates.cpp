@@ -0,0 +1,73 @@
+#include "remove_duplicates.h"
+
+#include <algorithm>
+
+namespace {
+
+bool HaveSameWords(const SearchServer::WordFrequencies& lhs, const SearchServer::WordFrequencies& rhs) {
+    return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](const auto& lhs_word, const auto& rhs_word) {
+        return lhs_word.first == rhs_word.first;
+    });
+}
+
+template <typename ExecutionPolicy>
+std::vector<int> RemoveDuplicatesWith(ExecutionPolicy policy, SearchServer& search_server) {
+    const std::vector<int> document_ids(search_server.begin(), search_server.end());
+    std::vector<std::pair<uint64_t, int>> hashes(document_ids.size());
+    std::transform(policy, document_ids.begin(), document_ids.end(), hashes.begin(), [&](int document_id) {
+        WordSetHasher hasher;
+        for (const auto& [word, _] : search_server.GetWordFrequencies(document_id)) {
+            hasher.Add(word);
+        }
+        return std::make_pair(hasher.Get(), document_id);
+    });
+    std::sort(policy, hashes.begin(), hashes.end());
+    
+    //в группе с одним хэшем документы идут по возрастанию id: документ - дубликат, если его слова совпали со словами
+    //одного из оставленных перед ним; разные наборы с одним хэшем попадаются только при коллизиях
+    std::vector<std::pair<size_t, size_t>> groups;
+    for (size_t begin = 0, end = 0; begin < hashes.size(); begin = end) {
+        for (end = begin; end < hashes.size() && hashes[end].first == hashes[begin].first; ++end) {
+        }
+        groups.emplace_back(begin, end);
+    }
+    std::vector<char> is_duplicate(hashes.size());
+    std::for_each(policy, groups.begin(), groups.end(), [&](const auto& group) {
+        const auto [begin, end] = group;
+        std::vector<const SearchServer::WordFrequencies*> kept;
+        for (size_t i = begin; i < end; ++i) {
+            const auto& word_freqs = search_server.GetWordFrequencies(hashes[i].second);
+            if (std::any_of(kept.begin(), kept.end(), [&](const auto* kept_word_freqs) { return HaveSameWords(*kept_word_freqs, word_freqs); })) {
+                is_duplicate[i] = 1;
+            } else {
+                kept.push_back(&word_freqs);
+            }
+        }
+    });
+    
+    std::vector<int> duplicates;
+    for (size_t i = 0; i < hashes.size(); ++i) {
+        if (is_duplicate[i]) {
+            duplicates.push_back(hashes[i].second);
+        }
+    }
+    std::sort(duplicates.begin(), duplicates.end());
+    for (const int document_id : duplicates) {
+        search_server.RemoveDocument(document_id);
+    }
+    return duplicates;
+}
+
+} // namespace
+
+std::vector<int> RemoveDuplicates(SearchServer& search_server) {
+    return RemoveDuplicates(std::execution::seq, search_server);
+}
+
+std::vector<int> RemoveDuplicates(const std::execution::sequenced_policy&, SearchServer& search_server) {
+    return RemoveDuplicatesWith(std::execution::seq, search_server);
+}
+
+std::vector<int> RemoveDuplicates(const std::execution::parallel_policy&, SearchServer& search_server) {
+    return RemoveDuplicatesWith(std::execution::par, search_server);
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "search_server.h"
+
+#include <execution>
+#include <vector>
+
+//Удаляет документы, набор слов которых (без учёта порядка и повторов) совпадает с набором слов документа с меньшим id.
+//Документы группируются по хэшу набора слов, и попарно сравниваются только документы внутри группы.
+//Возвращает id удалённых документов по возрастанию
+std::vector<int> RemoveDuplicates(SearchServer& search_server);
+std::vector<int> RemoveDuplicates(const std::execution::sequenced_policy&, SearchServer& search_server);
+std::vector<int> RemoveDuplicates(const std::execution::parallel_policy&, SearchServer& search_server);
@@ -0,0 +1,117 @@
+#include "request_queue.h"
+
+#include <algorithm>
+#include <limits>
+
+RequestQueue::RequestQueue(const SearchServer& search_server, std::chrono::seconds window)
+    : search_server_(search_server),
+      slot_seconds_(std::max<int64_t>(1, (window.count() + MAX_REQUEST_SLOTS - 1) / MAX_REQUEST_SLOTS)),
+      slots_(std::max<int64_t>(1, (window.count() + slot_seconds_ - 1) / slot_seconds_)) {
+}
+
+std::vector<Document> RequestQueue::AddFindRequest(std::string_view raw_query, DocumentStatus sought_status) {
+    const Clock::time_point start = Clock::now();
+    std::vector<Document> result = search_server_.FindTopDocuments(raw_query, sought_status);
+    Record(start, result.empty());
+    return result;
+}
+
+RequestStats RequestQueue::GetStats() const {
+    const int64_t now_index = GetSlotIndex(Clock::now());
+    
+    RequestStats stats;
+    std::array<uint64_t, LATENCY_BUCKET_COUNT> latencies{};
+    for (const Slot& slot : slots_) {
+        stats.requests += LoadCount(slot.requests, now_index);
+        stats.no_result_requests += LoadCount(slot.no_result_requests, now_index);
+        for (size_t i = 0; i < LATENCY_BUCKET_COUNT; ++i) {
+            latencies[i] += LoadCount(slot.latencies[i], now_index);
+        }
+    }
+    
+    //перцентиль - граница сверху (не включая) ячейки гистограммы, в которую он попал
+    uint64_t total = 0;
+    for (const uint64_t count : latencies) {
+        total += count;
+    }
+    std::chrono::microseconds* const percentiles[] = {&stats.p50, &stats.p95, &stats.p99};
+    const double ranks[] = {0.50, 0.95, 0.99};
+    for (size_t p = 0; p < 3; ++p) {
+        const uint64_t rank = static_cast<uint64_t>(ranks[p] * total + 0.5);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < LATENCY_BUCKET_COUNT; ++i) {
+            seen += latencies[i];
+            if (seen >= rank && seen > 0) {
+                *percentiles[p] = GetLatencyBucketBound(i);
+                break;
+            }
+        }
+    }
+    return stats;
+}
+
+size_t RequestQueue::GetLatencyBucket(uint64_t microseconds) {
+    if (microseconds < 4) {
+        return microseconds;
+    }
+    const int octave = 63 - __builtin_clzll(microseconds);
+    const size_t sub_bucket = (microseconds >> (octave - 2)) & 3;
+    return std::min(LATENCY_BUCKET_COUNT - 1, 4 + (octave - 2) * 4 + sub_bucket);
+}
+
+std::chrono::microseconds RequestQueue::GetLatencyBucketBound(size_t bucket) {
+    if (bucket < 4) {
+        return std::chrono::microseconds(bucket + 1);
+    }
+    const int octave = static_cast<int>((bucket - 4) / 4) + 2;
+    const int64_t sub_bucket = (bucket - 4) % 4;
+    return std::chrono::microseconds((5 + sub_bucket) << (octave - 2));
+}
+
+void RequestQueue::Increment(std::atomic<uint64_t>& counter, uint32_t epoch) {
+    uint64_t current = counter.load(std::memory_order_relaxed);
+    while (true) {
+        const uint32_t current_epoch = static_cast<uint32_t>(current >> 32);
+        uint64_t desired;
+        if (current_epoch == epoch) {
+            //насыщение вместо переноса в биты эпохи
+            if (static_cast<uint32_t>(current) == std::numeric_limits<uint32_t>::max()) {
+                return;
+            }
+            desired = current + 1;
+        } else if (static_cast<int32_t>(current_epoch - epoch) > 0) {
+            //запрос так задержался, что счётчик уже занят более новой эпохой - он вне окна
+            return;
+        } else {
+            desired = (static_cast<uint64_t>(epoch) << 32) | 1;
+        }
+        if (counter.compare_exchange_weak(current, desired, std::memory_order_relaxed)) {
+            return;
+        }
+    }
+}
+
+int64_t RequestQueue::GetSlotIndex(Clock::time_point time) const {
+    return std::chrono::duration_cast<std::chrono::seconds>(time.time_since_epoch()).count() / slot_seconds_;
+}
+
+uint64_t RequestQueue::LoadCount(const std::atomic<uint64_t>& counter, int64_t now_index) const {
+    const uint64_t value = counter.load(std::memory_order_relaxed);
+    //возраст эпохи считается по модулю 2^32, как и сама эпоха
+    const int32_t age = static_cast<int32_t>(static_cast<uint32_t>(now_index) - static_cast<uint32_t>(value >> 32));
+    return age >= 0 && age < static_cast<int64_t>(slots_.size()) ? static_cast<uint32_t>(value) : 0;
+}
+
+void RequestQueue::Record(Clock::time_point start, bool is_empty) {
+    const Clock::time_point finish = Clock::now();
+    const int64_t index = GetSlotIndex(finish);
+    Slot& slot = slots_[index % slots_.size()];
+    const uint32_t epoch = static_cast<uint32_t>(index);
+    
+    const auto latency = std::chrono::duration_cast<std::chrono::microseconds>(finish - start).count();
+    Increment(slot.requests, epoch);
+    if (is_empty) {
+        Increment(slot.no_result_requests, epoch);
+    }
+    Increment(slot.latencies[GetLatencyBucket(latency)], epoch);
+}
@@ -3,58 +3,69 @@
 #include "document.h"
 #include "search_server.h"
 
-#include <queue>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <string_view>
+#include <vector>
 
-const static size_t MIN_IN_DAY = 1440;
+const std::chrono::seconds DEFAULT_REQUEST_WINDOW = std::chrono::hours(24);
+const size_t MAX_REQUEST_SLOTS = 3600;
+const size_t LATENCY_BUCKET_COUNT = 120;
 
+//перцентили - строгие верхние оценки по гистограмме: задержка запроса меньше указанной
+struct RequestStats {
+    uint64_t requests = 0;
+    uint64_t no_result_requests = 0;
+    std::chrono::microseconds p50{0};
+    std::chrono::microseconds p95{0};
+    std::chrono::microseconds p99{0};
+};
+
+//Статистика запросов за скользящее окно реального времени. Окно разбито на ячейки кольцевого буфера,
+//по секунде на ячейку (для окон длиннее MAX_REQUEST_SLOTS секунд ячейка пропорционально шире).
+//Запись - только CAS отдельных счётчиков, так что AddFindRequest можно вызывать из многих потоков сразу
 class RequestQueue {
 public:
-    explicit RequestQueue(const SearchServer& search_server)  : search_server_(search_server), no_result_requests_(0) {}
+    using Clock = std::chrono::steady_clock;
+    
+    explicit RequestQueue(const SearchServer& search_server, std::chrono::seconds window = DEFAULT_REQUEST_WINDOW);
     
     template <typename DocumentPredicate>
-    std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentPredicate predicate);
-    std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentStatus sought_status = DocumentStatus::ACTUAL);
-
-    uint GetNoResultRequests() const { return no_result_requests_; }
+    std::vector<Document> AddFindRequest(std::string_view raw_query, DocumentPredicate predicate);
+    std::vector<Document> AddFindRequest(std::string_view raw_query, DocumentStatus sought_status = DocumentStatus::ACTUAL);
+    
+    uint GetNoResultRequests() const { return GetStats().no_result_requests; }
+    RequestStats GetStats() const;
     
 private:
-    struct QueryResult {
-        QueryResult(const std::string& query, int documents_found) : query(query), is_empty(!documents_found) {}
-        
-        bool empty() { return is_empty; }
-
-        std::string query;
-        bool is_empty;
+    //Каждый счётчик - одно атомарное слово: в старших 32 битах эпоха (номер ячейки времени, по модулю 2^32), в младших - счёт.
+    //Счётчик прошлой эпохи обнуляется тем же CAS, что и прибавляет, поэтому запись, задержавшаяся со старой эпохой,
+    //не попадёт в счёт новой. latencies - гистограмма задержек в микросекундах: до 4 мкс точно, дальше по 4 ячейки
+    //на каждую степень двойки
+    struct Slot {
+        std::atomic<uint64_t> requests{0};
+        std::atomic<uint64_t> no_result_requests{0};
+        std::array<std::atomic<uint64_t>, LATENCY_BUCKET_COUNT> latencies{};
     };
     
+    static size_t GetLatencyBucket(uint64_t microseconds);
+    static std::chrono::microseconds GetLatencyBucketBound(size_t bucket);
+    static void Increment(std::atomic<uint64_t>& counter, uint32_t epoch);
+    
+    int64_t GetSlotIndex(Clock::time_point time) const;
+    uint64_t LoadCount(const std::atomic<uint64_t>& counter, int64_t now_index) const; //0, если эпоха счётчика вне окна
+    void Record(Clock::time_point start, bool is_empty);
+    
     const SearchServer& search_server_;
-    std::queue<QueryResult> requests_;
-    uint no_result_requests_;
+    const int64_t slot_seconds_;
+    std::vector<Slot> slots_;
 };
 
 template <typename DocumentPredicate>
-std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentPredicate predicate) {
+std::vector<Document> RequestQueue::AddFindRequest(std::string_view raw_query, DocumentPredicate predicate) {
+    const Clock::time_point start = Clock::now();
     std::vector<Document> result = search_server_.FindTopDocuments(raw_query, predicate);
-    
-    //избавляемся от записей, старше суток
-    if (requests_.size() == MIN_IN_DAY) {
-        if (requests_.front().empty()) {
-            --no_result_requests_;
-        }
-        requests_.pop();
-    }
-    
-    requests_.emplace(raw_query, result.size());
-    
-    if (result.empty()) {
-        ++no_result_requests_;
-    }
-    
+    Record(start, result.empty());
     return result;
 }
-
-std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentStatus sought_status) {
-    return AddFindRequest(raw_query, [=](int document_id, DocumentStatus status, int rating) {
-                                              return status == sought_status;
-                                     });
-}
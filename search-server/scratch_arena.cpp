@@ -0,0 +1,35 @@
+#include "scratch_arena.h"
+
+#include <memory>
+
+namespace {
+
+struct ScratchArena {
+    std::unique_ptr<std::byte[]> buffer = std::make_unique<std::byte[]>(SCRATCH_ARENA_BUFFER_SIZE);
+    //буфер сверх постоянного берётся прямо у operator new, минуя ресурс по умолчанию, который мог подменить пользователь
+    std::pmr::monotonic_buffer_resource resource{buffer.get(), SCRATCH_ARENA_BUFFER_SIZE, std::pmr::new_delete_resource()};
+    size_t depth = 0;
+};
+
+ScratchArena& GetArena() {
+    thread_local ScratchArena arena;
+    return arena;
+}
+
+} // namespace
+
+ScratchScope::ScratchScope() {
+    ++GetArena().depth;
+}
+
+ScratchScope::~ScratchScope() {
+    ScratchArena& arena = GetArena();
+    if (--arena.depth == 0) {
+        //после release арена снова начинает с постоянного буфера
+        arena.resource.release();
+    }
+}
+
+std::pmr::memory_resource* ScratchScope::GetResource() {
+    return &GetArena().resource;
+}
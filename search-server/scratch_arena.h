@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+
+const size_t SCRATCH_ARENA_BUFFER_SIZE = 64 * 1024;
+
+//Временная память запросов. У каждого потока своя монотонная арена поверх постоянного буфера: выделение - сдвиг указателя,
+//память по одному не освобождается, а возвращается вся разом, когда закрывается внешняя ScratchScope потока.
+//Вложенные ScratchScope продолжают ту же арену. Контейнеры на арене не должны переживать свою ScratchScope,
+//уходить в другие потоки и пополняться из них
+class ScratchScope {
+public:
+    ScratchScope();
+    ~ScratchScope();
+    
+    ScratchScope(const ScratchScope&) = delete;
+    ScratchScope& operator=(const ScratchScope&) = delete;
+    
+    //арена текущего потока; ею можно пользоваться, пока в потоке открыта хотя бы одна ScratchScope
+    static std::pmr::memory_resource* GetResource();
+};
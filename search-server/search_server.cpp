@@ -1,11 +1,251 @@
 #include "search_server.h"
 
+#include <cassert>
+#include <charconv>
 #include <cmath>
+#include <future>
+#include <iterator>
 #include <numeric>
+#include <thread>
+#include <unordered_map>
 
 using namespace std::string_literals;
 
-const std::set<std::string>& SearchServer::GetStopWords() const {
+namespace {
+
+int ParseNumber(std::string_view text) {
+    int value = 0;
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (text.empty() || error != std::errc() || end != text.data() + text.size()) {
+        throw std::invalid_argument("invalid number "s + std::string(text));
+    }
+    return value;
+}
+
+DocumentStatus ParseDocumentStatus(std::string_view text) {
+    static const std::pair<std::string_view, DocumentStatus> statuses[] = {
+        {"ACTUAL", DocumentStatus::ACTUAL},
+        {"IRRELEVANT", DocumentStatus::IRRELEVANT},
+        {"BANNED", DocumentStatus::BANNED},
+        {"REMOVED", DocumentStatus::REMOVED},
+    };
+    for (const auto& [name, status] : statuses) {
+        if (name == text) {
+            return status;
+        }
+    }
+    throw std::invalid_argument("unknown document status "s + std::string(text));
+}
+
+//id, статус и рейтинги отделены табуляцией, всё после третьей табуляции - текст документа
+NewDocument ParseDocumentLine(std::string_view line) {
+    std::string_view fields[3];
+    for (std::string_view& field : fields) {
+        const size_t tab = line.find('\t');
+        if (tab == line.npos) {
+            throw std::invalid_argument("expected id, status, ratings and text separated by tabs"s);
+        }
+        field = line.substr(0, tab);
+        line.remove_prefix(tab + 1);
+    }
+    
+    NewDocument document;
+    document.id = ParseNumber(fields[0]);
+    document.status = ParseDocumentStatus(fields[1]);
+    for (const std::string_view rating : SplitIntoWordsView(fields[2])) {
+        document.ratings.push_back(ParseNumber(rating));
+    }
+    document.text = line;
+    return document;
+}
+
+//границы кусков, на которые делится пакет: по несколько на поток, чтобы потоки не простаивали из-за неравных кусков
+std::vector<std::pair<size_t, size_t>> SplitIntoChunks(size_t size) {
+    const size_t chunk_count = std::clamp<size_t>(std::thread::hardware_concurrency() * 4, 1, std::max<size_t>(size, 1));
+    std::vector<std::pair<size_t, size_t>> chunks;
+    for (size_t i = 0; i < chunk_count; ++i) {
+        chunks.emplace_back(size * i / chunk_count, size * (i + 1) / chunk_count);
+    }
+    return chunks;
+}
+
+const size_t PREFIX_MERGE_WINDOW_SIZE = 8192; //массив частот окна - 64 КиБ, помещается в кэш второго уровня
+
+} // namespace
+
+SearchServer::SearchServer(SnapshotReader& snapshot, std::pmr::memory_resource* resource)
+    : stop_words_(ParseStopWords(snapshot.ReadStrings(snapshot.GetHeader().stop_word_count))),
+      word_to_term_id_(resource),
+      document_to_word_freqs_(resource),
+      mapped_word_freqs_(std::make_unique<WordFrequenciesCache>(resource)),
+      documents_(resource),
+      document_ids_(resource) {
+    static_assert(std::is_same_v<int32_t, int>, "snapshot arrays of int32_t are read in place as int");
+    const SnapshotHeader& header = snapshot.GetHeader();
+    const size_t document_count = header.document_count;
+    
+    const int32_t* document_ids = snapshot.ReadArray<int32_t>(document_count);
+    const int32_t* ratings = snapshot.ReadArray<int32_t>(document_count);
+    const int32_t* statuses = snapshot.ReadArray<int32_t>(document_count);
+    for (size_t i = 0; i < document_count; ++i) {
+        if (document_ids[i] < 0 || (i > 0 && document_ids[i] <= document_ids[i - 1])
+            || statuses[i] < static_cast<int32_t>(DocumentStatus::ACTUAL) || statuses[i] > static_cast<int32_t>(DocumentStatus::REMOVED)) {
+            throw std::invalid_argument("snapshot has invalid document entry "s + std::to_string(i));
+        }
+        AddDocumentData(document_ids[i], DocumentData{ratings[i], static_cast<DocumentStatus>(statuses[i])});
+    }
+    
+    //постинги не копируются: списки читают массивы прямо из файла, поэтому сервер держит отображение
+    if (header.term_count > std::numeric_limits<uint32_t>::max()) {
+        throw std::invalid_argument("snapshot has too many terms"s);
+    }
+    const std::vector<std::string_view> terms = snapshot.ReadStrings(header.term_count);
+    const uint64_t* posting_counts = snapshot.ReadArray<uint64_t>(header.term_count);
+    postings_.resize(header.term_count);
+    mapped_forward_index_.terms.reserve(header.term_count);
+    size_t posting_count = 0;
+    for (size_t term_id = 0; term_id < header.term_count; ++term_id) {
+        //слова в снимке отсортированы, поэтому каждое встаёт в конец словаря
+        const auto it = word_to_term_id_.emplace_hint(word_to_term_id_.end(), terms[term_id], term_id);
+        if (it->second != term_id || !IsValidWord(terms[term_id])) {
+            throw std::invalid_argument("snapshot has invalid term "s + std::string(terms[term_id]));
+        }
+        mapped_forward_index_.terms.push_back(it->first);
+        
+        PostingList& posting_list = postings_[term_id];
+        posting_list.mapped_count = posting_counts[term_id];
+        posting_list.mapped_document_ids = snapshot.ReadArray<int32_t>(posting_list.mapped_count);
+        posting_list.mapped_term_freqs = snapshot.ReadArray<double>(posting_list.mapped_count);
+        posting_count += posting_list.mapped_count;
+    }
+    
+    //прямой индекс: отрезок term id слов каждого документа
+    const uint64_t* word_offsets = snapshot.ReadArray<uint64_t>(document_count + 1);
+    const uint32_t* term_ids = snapshot.ReadArray<uint32_t>(posting_count);
+    if (word_offsets[0] != 0 || word_offsets[document_count] != posting_count) {
+        throw std::invalid_argument("snapshot has invalid forward index"s);
+    }
+    for (size_t i = 0; i < document_count; ++i) {
+        if (word_offsets[i] > word_offsets[i + 1]) {
+            throw std::invalid_argument("snapshot has invalid forward index"s);
+        }
+    }
+    
+    //Прямой индекс сверяется с постингами без поиска: документы перебираются по возрастанию id, поэтому каждый список
+    //прочитывается по порядку, а в конце все списки должны быть прочитаны целиком
+    std::vector<size_t> next_posting(postings_.size());
+    for (size_t position = 0; position < document_count; ++position) {
+        for (uint64_t i = word_offsets[position]; i < word_offsets[position + 1]; ++i) {
+            if (term_ids[i] >= postings_.size() || (i > word_offsets[position] && term_ids[i] <= term_ids[i - 1])) {
+                throw std::invalid_argument("snapshot has invalid forward index for document "s + std::to_string(document_ids[position]));
+            }
+            PostingList& posting_list = postings_[term_ids[i]];
+            size_t& pos = next_posting[term_ids[i]];
+            //!(> 0.0) отвергает и NaN
+            if (pos == posting_list.mapped_count || posting_list.mapped_document_ids[pos] != document_ids[position]
+                || !(posting_list.mapped_term_freqs[pos] > 0.0) || !std::isfinite(posting_list.mapped_term_freqs[pos])) {
+                throw std::invalid_argument("snapshot has invalid postings for term "s + std::string(mapped_forward_index_.terms[term_ids[i]]));
+            }
+            posting_list.max_term_freq = std::max(posting_list.max_term_freq, posting_list.mapped_term_freqs[pos]);
+            ++pos;
+        }
+    }
+    for (size_t term_id = 0; term_id < postings_.size(); ++term_id) {
+        if (next_posting[term_id] != postings_[term_id].mapped_count) {
+            throw std::invalid_argument("snapshot has invalid postings for term "s + std::string(mapped_forward_index_.terms[term_id]));
+        }
+    }
+    
+    mapped_forward_index_.mapping = snapshot.GetMapping();
+    mapped_forward_index_.document_ids = document_ids;
+    mapped_forward_index_.document_count = document_count;
+    mapped_forward_index_.word_offsets = word_offsets;
+    mapped_forward_index_.term_ids = term_ids;
+}
+
+void SearchServer::SaveSnapshot(const std::string& path) const {
+    SnapshotWriter writer(path);
+    SnapshotHeader header{};
+    
+    header.stop_word_count = stop_words_.size();
+    writer.WriteStrings({stop_words_.begin(), stop_words_.end()});
+    
+    header.document_count = documents_.size();
+    std::vector<int32_t> document_ids, ratings, statuses;
+    for (const auto& [document_id, document_data] : documents_) {
+        document_ids.push_back(document_id);
+        ratings.push_back(document_data.rating);
+        statuses.push_back(static_cast<int32_t>(document_data.status));
+    }
+    writer.WriteArray(document_ids);
+    writer.WriteArray(ratings);
+    writer.WriteArray(statuses);
+    
+    //в снимок попадают только слова с живыми постингами, пометки удалённых документов отбрасываются
+    std::vector<std::string_view> terms;
+    std::vector<const PostingList*> posting_lists;
+    std::vector<uint64_t> posting_counts;
+    for (const auto& [word, term_id] : word_to_term_id_) {
+        if (postings_[term_id].size() != 0) {
+            terms.push_back(word);
+            posting_lists.push_back(&postings_[term_id]);
+            posting_counts.push_back(postings_[term_id].size());
+            header.posting_count += postings_[term_id].size();
+        }
+    }
+    header.term_count = terms.size();
+    writer.WriteStrings(terms);
+    writer.WriteArray(posting_counts);
+    
+    //попутно для каждого постинга запоминается номер его документа, чтобы затем собрать прямой индекс
+    std::vector<int32_t> posting_document_ids;
+    std::vector<double> term_freqs;
+    std::vector<uint32_t> document_positions;
+    document_positions.reserve(header.posting_count);
+    std::vector<uint64_t> word_offsets(document_ids.size() + 1);
+    //номер документа по id: плотные id (обычный случай) индексируют массив, а разреженные ищутся в хэш-таблице
+    const bool is_dense = document_ids.empty() || static_cast<size_t>(document_ids.back()) < 2 * document_ids.size();
+    std::vector<uint32_t> dense_positions(is_dense && !document_ids.empty() ? document_ids.back() + 1 : 0);
+    std::unordered_map<int, uint32_t> sparse_positions;
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        if (is_dense) {
+            dense_positions[document_ids[i]] = i;
+        } else {
+            sparse_positions.emplace(document_ids[i], i);
+        }
+    }
+    for (const PostingList* posting_list : posting_lists) {
+        posting_document_ids.clear();
+        term_freqs.clear();
+        posting_list->ForEach([&](int document_id, double term_freq) {
+            posting_document_ids.push_back(document_id);
+            term_freqs.push_back(term_freq);
+            const uint32_t position = is_dense ? dense_positions[document_id] : sparse_positions.at(document_id);
+            document_positions.push_back(position);
+            ++word_offsets[position + 1];
+        });
+        writer.WriteArray(posting_document_ids);
+        writer.WriteArray(term_freqs);
+    }
+    
+    //Прямой индекс собирается сортировкой подсчётом по документам. Слова перебирались по возрастанию, поэтому
+    //term id каждого документа сразу упорядочены
+    std::partial_sum(word_offsets.begin(), word_offsets.end(), word_offsets.begin());
+    std::vector<uint32_t> term_ids(document_positions.size());
+    std::vector<uint64_t> next_word = word_offsets;
+    size_t posting_index = 0;
+    for (size_t term_id = 0; term_id < posting_lists.size(); ++term_id) {
+        for (size_t i = 0; i < posting_counts[term_id]; ++i) {
+            term_ids[next_word[document_positions[posting_index++]]++] = term_id;
+        }
+    }
+    writer.WriteArray(word_offsets);
+    writer.WriteArray(term_ids);
+    
+    writer.Finish(header);
+}
+
+const std::set<std::string, std::less<>>& SearchServer::GetStopWords() const {
     return stop_words_;
 }
 
@@ -13,15 +253,112 @@ size_t SearchServer::GetDocumentCount() const {
     return documents_.size();
 }
 
-int SearchServer::GetDocumentId(uint n) const {
-    return document_ids_.at(n);
+std::pmr::set<int>::const_iterator SearchServer::begin() const {
+    return document_ids_.begin();
+}
+
+std::pmr::set<int>::const_iterator SearchServer::end() const {
+    return document_ids_.end();
+}
+
+bool SearchServer::HasDocument(int document_id) const {
+    return documents_.count(document_id) != 0;
+}
+
+size_t SearchServer::GetDocumentFrequency(std::string_view word, std::string_view prefix_last_word) const {
+    PostingList prefix_postings;
+    const PostingList* posting_list = FindQueryPostingList(word, prefix_last_word, prefix_postings);
+    return posting_list ? posting_list->size() : 0;
+}
+
+std::string_view SearchServer::Query::FindPrefixLastWord(std::string_view word) const {
+    const auto it = std::lower_bound(prefix_words.begin(), prefix_words.end(), word);
+    if (it == prefix_words.end() || *it != word) {
+        return {};
+    }
+    return prefix_last_words[it - prefix_words.begin()];
+}
+
+std::vector<std::string_view> SearchServer::GetPrefixWords(const Query& query) {
+    std::vector<std::string_view> prefix_words;
+    for (const auto* words : {&query.plus_words, &query.minus_words}) {
+        std::copy_if(words->begin(), words->end(), std::back_inserter(prefix_words), IsPrefixWord);
+    }
+    std::sort(prefix_words.begin(), prefix_words.end());
+    prefix_words.erase(std::unique(prefix_words.begin(), prefix_words.end()), prefix_words.end());
+    return prefix_words;
+}
+
+std::vector<std::vector<std::string>> SearchServer::GetPrefixExpansions(const Query& query) const {
+    std::vector<std::vector<std::string>> expansions;
+    for (const std::string_view prefix_word : GetPrefixWords(query)) {
+        std::vector<std::string>& words = expansions.emplace_back();
+        ForEachPrefixExpansion(prefix_word, {}, [&words](std::string_view word, const PostingList&) {
+            words.emplace_back(word);
+        });
+    }
+    return expansions;
+}
+
+void SearchServer::BoundPrefixExpansions(Query& query, const std::vector<std::vector<std::vector<std::string>>>& part_expansions) {
+    const std::vector<std::string_view> prefix_words = GetPrefixWords(query);
+    query.prefix_words.clear();
+    query.prefix_last_words.clear();
+    for (size_t i = 0; i < prefix_words.size(); ++i) {
+        std::vector<std::string_view> words;
+        for (const std::vector<std::vector<std::string>>& expansions : part_expansions) {
+            words.insert(words.end(), expansions[i].begin(), expansions[i].end());
+        }
+        std::sort(words.begin(), words.end());
+        words.erase(std::unique(words.begin(), words.end()), words.end());
+        //если слов меньше, ни одна часть не упёрлась в предел и раскрывает префикс целиком
+        if (words.size() < MAX_PREFIX_EXPANSION_COUNT) {
+            continue;
+        }
+        query.prefix_words.push_back(prefix_words[i]);
+        query.prefix_last_words.emplace_back(words[MAX_PREFIX_EXPANSION_COUNT - 1]);
+    }
+}
+
+const SearchServer::WordFrequencies& SearchServer::GetWordFrequencies(int document_id) const {
+    static const WordFrequencies empty_map;
+    
+    const auto it = document_to_word_freqs_.find(document_id);
+    if (it != document_to_word_freqs_.end()) {
+        return it->second;
+    }
+    if (documents_.count(document_id) == 0) {
+        return empty_map;
+    }
+    
+    //карта документа из снимка собирается один раз: слова - по его отрезку прямого индекса, частоты - из постингов
+    std::lock_guard guard(mapped_word_freqs_->mutex);
+    const auto [cached, is_new] = mapped_word_freqs_->documents.try_emplace(document_id);
+    if (is_new) {
+        const auto [begin, end] = FindMappedDocumentWords(document_id);
+        for (const uint32_t* term_id = begin; term_id != end; ++term_id) {
+            cached->second.emplace_hint(cached->second.end(), mapped_forward_index_.terms[*term_id], postings_[*term_id].FindTermFreq(document_id));
+        }
+    }
+    return cached->second;
+}
+
+std::pair<const uint32_t*, const uint32_t*> SearchServer::FindMappedDocumentWords(int document_id) const {
+    const MappedForwardIndex& index = mapped_forward_index_;
+    const int* end = index.document_ids + index.document_count;
+    const int* it = std::lower_bound(index.document_ids, end, document_id);
+    if (it == end || *it != document_id) {
+        return {nullptr, nullptr};
+    }
+    const size_t position = it - index.document_ids;
+    return {index.term_ids + index.word_offsets[position], index.term_ids + index.word_offsets[position + 1]};
 }
 
-bool SearchServer::IsValidWord(const std::string& word) {
+bool SearchServer::IsValidWord(std::string_view word) {
     return std::none_of(word.begin(), word.end(), [](char c) { return c >= '\0' && c < ' '; });
 }
 
-bool SearchServer::IsStopWord(const std::string& word) const {
+bool SearchServer::IsStopWord(std::string_view word) const {
     return stop_words_.count(word) != 0;
 }
 
@@ -33,34 +370,741 @@ int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
     return rating_sum / static_cast<int>(ratings.size());
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const std::string& word) const {
-    return std::log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+uint64_t SearchServer::ComputeWordSetHash(int document_id) const {
+    WordSetHasher hasher;
+    ForEachDocumentWord(document_id, [&](std::string_view word) {
+        hasher.Add(word);
+    });
+    return hasher.Get();
+}
+
+void SearchServer::UnindexWordSet(int document_id) {
+    if (!word_set_to_documents_) {
+        return;
+    }
+    const auto [begin, end] = word_set_to_documents_->equal_range(ComputeWordSetHash(document_id));
+    const auto it = std::find_if(begin, end, [=](const auto& entry) {
+        return entry.second == document_id;
+    });
+    if (it != end) {
+        word_set_to_documents_->erase(it);
+    }
+}
+
+void SearchServer::SetSkipDuplicates(bool skip) {
+    if (!skip) {
+        word_set_to_documents_.reset();
+        return;
+    }
+    if (word_set_to_documents_) {
+        return;
+    }
+    word_set_to_documents_ = std::make_unique<std::unordered_multimap<uint64_t, int>>();
+    for (const auto& [document_id, _] : documents_) {
+        word_set_to_documents_->emplace(ComputeWordSetHash(document_id), document_id);
+    }
+}
+
+void SearchServer::CompressPostings() {
+    std::for_each(std::execution::par, postings_.begin(), postings_.end(), [](PostingList& posting_list) {
+        posting_list.Compress();
+    });
+}
+
+size_t SearchServer::GetPostingsMemoryUsage() const {
+    size_t bytes = postings_.capacity() * sizeof(PostingList);
+    for (const PostingList& posting_list : postings_) {
+        bytes += posting_list.GetMemoryUsage();
+    }
+    return bytes;
+}
+
+size_t SearchServer::PostingList::GetMemoryUsage() const {
+    const size_t compressed_bytes = compressed ? sizeof(CompressedPostingList) + compressed->GetMemoryUsage() : 0;
+    return compressed_bytes + document_ids.capacity() * sizeof(int) + term_freqs.capacity() * sizeof(double);
+}
+
+bool SearchServer::PostingList::Contains(int document_id) const {
+    if (compressed) {
+        return compressed->Contains(document_id);
+    }
+    const int* ids = GetDocumentIds();
+    const int* end = ids + GetStoredCount();
+    const int* it = std::lower_bound(ids, end, document_id);
+    return it != end && *it == document_id && GetTermFreqs()[it - ids] != 0.0;
+}
+
+double SearchServer::PostingList::FindTermFreq(int document_id) const {
+    Cursor cursor(*this);
+    cursor.SeekTo(document_id);
+    return !cursor.IsExhausted() && cursor.CurrentId() == document_id ? cursor.CurrentTermFreq() : 0.0;
+}
+
+void SearchServer::PostingList::Add(int document_id, double term_freq) {
+    MakeOwned();
+    //документы обычно добавляются по возрастанию id, тогда это просто дописывание в конец
+    if (document_ids.empty() || document_ids.back() < document_id) {
+        document_ids.push_back(document_id);
+        term_freqs.push_back(term_freq);
+        max_term_freq = std::max(max_term_freq, term_freq);
+        return;
+    }
+    
+    const auto it = std::lower_bound(document_ids.begin(), document_ids.end(), document_id);
+    const size_t pos = it - document_ids.begin();
+    if (it != document_ids.end() && *it == document_id) {
+        if (term_freqs[pos] == 0.0) {
+            --removed_count;
+        }
+        term_freqs[pos] += term_freq;
+    } else {
+        document_ids.insert(it, document_id);
+        term_freqs.insert(term_freqs.begin() + pos, term_freq);
+    }
+    max_term_freq = std::max(max_term_freq, term_freqs[pos]);
+}
+
+void SearchServer::PostingList::Remove(int document_id) {
+    MakeOwned();
+    const auto it = std::lower_bound(document_ids.begin(), document_ids.end(), document_id);
+    if (it == document_ids.end() || *it != document_id || term_freqs[it - document_ids.begin()] == 0.0) {
+        return;
+    }
+    term_freqs[it - document_ids.begin()] = 0.0;
+    ++removed_count;
+    
+    if (removed_count * 2 <= document_ids.size()) {
+        return;
+    }
+    size_t live = 0;
+    max_term_freq = 0.0;
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        if (term_freqs[i] != 0.0) {
+            document_ids[live] = document_ids[i];
+            term_freqs[live] = term_freqs[i];
+            max_term_freq = std::max(max_term_freq, term_freqs[i]);
+            ++live;
+        }
+    }
+    document_ids.resize(live);
+    term_freqs.resize(live);
+    removed_count = 0;
+}
+
+void SearchServer::PostingList::Merge(const PostingList& other) {
+    if (other.compressed) {
+        PostingList unpacked;
+        other.ForEach([&](int document_id, double term_freq) {
+            unpacked.document_ids.push_back(document_id);
+            unpacked.term_freqs.push_back(term_freq);
+        });
+        unpacked.max_term_freq = other.max_term_freq;
+        Merge(unpacked);
+        return;
+    }
+    MakeOwned();
+    const int* other_ids = other.GetDocumentIds();
+    const double* other_freqs = other.GetTermFreqs();
+    const size_t other_count = other.GetStoredCount();
+    
+    //документы обычно приходят по возрастанию id, тогда достаточно дописать другой список в конец
+    if (document_ids.empty() || other_count == 0 || document_ids.back() < other_ids[0]) {
+        for (size_t i = 0; i < other_count; ++i) {
+            if (other_freqs[i] != 0.0) {
+                document_ids.push_back(other_ids[i]);
+                term_freqs.push_back(other_freqs[i]);
+            }
+        }
+        max_term_freq = std::max(max_term_freq, other.max_term_freq);
+        return;
+    }
+    
+    std::vector<int> merged_ids;
+    std::vector<double> merged_freqs;
+    merged_ids.reserve(size() + other.size());
+    merged_freqs.reserve(size() + other.size());
+    
+    size_t i = 0;
+    size_t j = 0;
+    while (i < document_ids.size() || j < other_count) {
+        const bool take_own = j == other_count || (i < document_ids.size() && document_ids[i] < other_ids[j]);
+        const int* source_ids = take_own ? document_ids.data() : other_ids;
+        const double* source_freqs = take_own ? term_freqs.data() : other_freqs;
+        const size_t pos = take_own ? i++ : j++;
+        if (source_freqs[pos] != 0.0) {
+            merged_ids.push_back(source_ids[pos]);
+            merged_freqs.push_back(source_freqs[pos]);
+        }
+    }
+    
+    document_ids = std::move(merged_ids);
+    term_freqs = std::move(merged_freqs);
+    max_term_freq = std::max(max_term_freq, other.max_term_freq);
+    removed_count = 0;
+}
+
+void SearchServer::PostingList::Compress() {
+    if (compressed || size() < MIN_COMPRESSED_POSTING_COUNT) {
+        return;
+    }
+    MakeOwned();
+    compressed = std::make_unique<const CompressedPostingList>(document_ids, term_freqs);
+    //присваивание {} сохранило бы ёмкость массивов
+    document_ids = std::vector<int>();
+    term_freqs = std::vector<double>();
+    removed_count = 0;
 }
 
-void SearchServer::AddDocument(int document_id, const std::string& document, DocumentStatus status, const std::vector<int>& ratings) {
+void SearchServer::PostingList::Decompress() {
+    if (!compressed) {
+        return;
+    }
+    document_ids.reserve(compressed->size());
+    term_freqs.reserve(compressed->size());
+    compressed->ForEach([&](int document_id, double term_freq) {
+        document_ids.push_back(document_id);
+        term_freqs.push_back(term_freq);
+    });
+    compressed.reset();
+}
+
+void SearchServer::PostingList::MakeOwned() {
+    Decompress();
+    if (!mapped_document_ids) {
+        return;
+    }
+    document_ids.assign(mapped_document_ids, mapped_document_ids + mapped_count);
+    term_freqs.assign(mapped_term_freqs, mapped_term_freqs + mapped_count);
+    mapped_document_ids = nullptr;
+    mapped_term_freqs = nullptr;
+    mapped_count = 0;
+}
+
+SearchServer::PostingList::Cursor::Cursor(const PostingList& posting_list) {
+    if (posting_list.compressed) {
+        compressed_ = std::make_unique<CompressedPostingList::Cursor>(*posting_list.compressed);
+    } else {
+        document_ids_ = posting_list.GetDocumentIds();
+        term_freqs_ = posting_list.GetTermFreqs();
+        count_ = posting_list.GetStoredCount();
+        SkipRemoved();
+    }
+}
+
+void SearchServer::PostingList::Cursor::Next() {
+    if (compressed_) {
+        compressed_->Next();
+        return;
+    }
+    ++pos_;
+    SkipRemoved();
+}
+
+void SearchServer::PostingList::Cursor::SeekTo(int document_id) {
+    if (compressed_) {
+        compressed_->SeekTo(document_id);
+        return;
+    }
+    pos_ = std::lower_bound(document_ids_ + pos_, document_ids_ + count_, document_id) - document_ids_;
+    SkipRemoved();
+}
+
+void SearchServer::PostingList::Cursor::SkipRemoved() {
+    while (pos_ < count_ && term_freqs_[pos_] == 0.0) {
+        ++pos_;
+    }
+}
+
+void SearchServer::AddDocumentData(int document_id, const DocumentData& document_data) {
+    documents_.emplace_hint(documents_.end(), document_id, document_data);
+    document_ids_.emplace_hint(document_ids_.end(), document_id);
+    status_documents_[static_cast<size_t>(document_data.status)].Add(document_id);
+}
+
+void SearchServer::RemoveDocumentData(int document_id) {
+    const auto it = documents_.find(document_id);
+    status_documents_[static_cast<size_t>(it->second.status)].Remove(document_id);
+    documents_.erase(it);
+    document_ids_.erase(document_id);
+}
+
+const SearchServer::PostingList* SearchServer::FindPostingList(std::string_view word) const {
+    const auto it = word_to_term_id_.find(word);
+    if (it == word_to_term_id_.end() || postings_[it->second].size() == 0) {
+        return nullptr;
+    }
+    return &postings_[it->second];
+}
+
+SearchServer::PostingList& SearchServer::GetPostingList(std::string_view word) {
+    return postings_[word_to_term_id_.find(word)->second];
+}
+
+bool SearchServer::IsPrefixWord(std::string_view word) {
+    return word.size() > 1 && word.back() == '*' && word[word.size() - 2] != '*';
+}
+
+std::string_view SearchServer::GetExactWord(std::string_view word) {
+    //cat** -> cat*
+    if (word.size() > 1 && word.back() == '*' && word[word.size() - 2] == '*') {
+        word.remove_suffix(1);
+    }
+    return word;
+}
+
+const TermDictionary& SearchServer::GetTermDictionary() const {
+    //Слова из word_to_term_id_ не удаляются, поэтому словарь устарел, только если их стало больше.
+    //Код, который начнёт удалять слова, должен сам сбрасывать term_dictionary_->dictionary: иначе после удаления
+    //и добавления поровну словарь молча останется старым. Уменьшение числа слов assert хотя бы поймает
+    std::lock_guard guard(term_dictionary_->mutex);
+    assert(!term_dictionary_->dictionary || term_dictionary_->dictionary->size() <= word_to_term_id_.size());
+    if (!term_dictionary_->dictionary || term_dictionary_->dictionary->size() != word_to_term_id_.size()) {
+        term_dictionary_->dictionary = std::make_unique<const TermDictionary>(word_to_term_id_);
+    }
+    return *term_dictionary_->dictionary;
+}
+
+const SearchServer::PostingList* SearchServer::FindQueryPostingList(std::string_view word, std::string_view prefix_last_word, PostingList& storage,
+                                                                    const QueryBudget* budget) const {
+    if (!IsPrefixWord(word)) {
+        return FindPostingList(GetExactWord(word));
+    }
+    
+    ScratchScope scope;
+    std::pmr::vector<const PostingList*> posting_lists(ScratchScope::GetResource());
+    ForEachQueryPostingList(word, prefix_last_word, [&](const PostingList& posting_list) {
+        posting_lists.push_back(&posting_list);
+    });
+    if (posting_lists.size() <= 1) {
+        return posting_lists.empty() ? nullptr : posting_lists.front();
+    }
+    
+    //Слияние идёт окнами по PREFIX_MERGE_WINDOW_SIZE id, начиная с наименьшего текущего id: каждый курсор выкладывает
+    //постинги окна в битовую карту и массив частот, а затем документы окна выписываются по возрастанию обходом карты.
+    //Так на постинг приходится одно сложение, а не операция с кучей, сколько бы слов ни дал префикс.
+    //Курсоры остаются в порядке словаря, поэтому частоты одного документа всегда складываются в одном порядке
+    std::pmr::vector<PostingList::Cursor> cursors(ScratchScope::GetResource());
+    size_t posting_count = 0;
+    for (const PostingList* posting_list : posting_lists) {
+        cursors.emplace_back(*posting_list);
+        posting_count += posting_list->size();
+    }
+    std::pmr::vector<uint64_t> window_bits(PREFIX_MERGE_WINDOW_SIZE / 64, 0, ScratchScope::GetResource());
+    std::pmr::vector<double> window_term_freqs(PREFIX_MERGE_WINDOW_SIZE, 0.0, ScratchScope::GetResource());
+    
+    storage.document_ids.clear();
+    storage.term_freqs.clear();
+    storage.max_term_freq = 0.0;
+    storage.document_ids.reserve(posting_count);
+    storage.term_freqs.reserve(posting_count);
+    //срок проверяется, как и при обходе списков, раз в POSTING_BLOCK_SIZE постингов
+    size_t merged_count = 0;
+    while (true) {
+        cursors.erase(std::remove_if(cursors.begin(), cursors.end(), [](const PostingList::Cursor& cursor) {
+            return cursor.IsExhausted();
+        }), cursors.end());
+        if (cursors.empty()) {
+            break;
+        }
+        const int window_begin = std::min_element(cursors.begin(), cursors.end(), [](const PostingList::Cursor& lhs, const PostingList::Cursor& rhs) {
+            return lhs.CurrentId() < rhs.CurrentId();
+        })->CurrentId();
+        
+        for (PostingList::Cursor& cursor : cursors) {
+            for (; !cursor.IsExhausted(); cursor.Next()) {
+                const size_t offset = static_cast<size_t>(cursor.CurrentId()) - static_cast<size_t>(window_begin);
+                if (offset >= PREFIX_MERGE_WINDOW_SIZE) {
+                    break;
+                }
+                if (budget && ++merged_count % POSTING_BLOCK_SIZE == 0 && budget->ShouldStop()) {
+                    return storage.document_ids.empty() ? nullptr : &storage;
+                }
+                window_bits[offset / 64] |= uint64_t{1} << (offset % 64);
+                window_term_freqs[offset] += cursor.CurrentTermFreq();
+            }
+        }
+        for (size_t i = 0; i < window_bits.size(); ++i) {
+            for (uint64_t word = window_bits[i]; word != 0; word &= word - 1) {
+                const size_t offset = i * 64 + __builtin_ctzll(word);
+                storage.document_ids.push_back(window_begin + static_cast<int>(offset));
+                storage.term_freqs.push_back(window_term_freqs[offset]);
+                storage.max_term_freq = std::max(storage.max_term_freq, window_term_freqs[offset]);
+                window_term_freqs[offset] = 0.0;
+            }
+            window_bits[i] = 0;
+        }
+    }
+    return &storage;
+}
+
+template <typename Stats>
+bool SearchServer::ContainsQueryWord(std::string_view word, std::string_view prefix_last_word, int document_id, Stats& stats) const {
+    bool is_contained = false;
+    ForEachQueryPostingList(word, prefix_last_word, [&](const PostingList& posting_list) {
+        if constexpr (Stats::enabled) {
+            ++stats.postings_scanned;
+        }
+        is_contained = is_contained || posting_list.Contains(document_id);
+    });
+    return is_contained;
+}
+
+double SearchServer::ComputeWordInverseDocumentFreq(const Query& query, size_t word_index, const PostingList& posting_list) const {
+    if (!query.plus_word_idfs.empty()) {
+        return query.plus_word_idfs[word_index];
+    }
+    return std::log(GetDocumentCount() * 1.0 / posting_list.size());
+}
+
+bool SearchServer::IsMoreRelevant(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
+        if (lhs.rating != rhs.rating) {
+            return lhs.rating > rhs.rating;
+        }
+        return lhs.id < rhs.id;
+    }
+    return lhs.relevance > rhs.relevance;
+}
+
+void SearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
     if (document_id < 0 || documents_.count(document_id) != 0) {
         throw std::invalid_argument("document id "s + std::to_string(document_id) + " is invalid or already exists"s);
     }
     
-    std::vector<std::string> words = ParseDocument(document);
+    ScratchScope scope;
+    const std::pmr::vector<std::string_view> words = ParseDocument(document, ScratchScope::GetResource());
     //if (words.empty()) {
     //    throw std::invalid_argument("document id "s + std::to_string(document_id) + " has no valid plus words"s);
     //}
     
+    if (word_set_to_documents_) {
+        std::pmr::vector<std::string_view> word_set(words.begin(), words.end(), ScratchScope::GetResource());
+        std::sort(word_set.begin(), word_set.end());
+        word_set.erase(std::unique(word_set.begin(), word_set.end()), word_set.end());
+        WordSetHasher hasher;
+        for (const std::string_view word : word_set) {
+            hasher.Add(word);
+        }
+        
+        //совпадение хэшей перепроверяется по самим словам
+        const auto [begin, end] = word_set_to_documents_->equal_range(hasher.Get());
+        std::pmr::vector<std::string_view> other_word_set(ScratchScope::GetResource());
+        const auto duplicate = std::find_if(begin, end, [&](const auto& entry) {
+            other_word_set.clear();
+            ForEachDocumentWord(entry.second, [&](std::string_view word) {
+                other_word_set.push_back(word);
+            });
+            return word_set == other_word_set;
+        });
+        if (duplicate != end) {
+            if (duplicate->second < document_id) {
+                return;
+            }
+            RemoveDocument(duplicate->second);
+        }
+        word_set_to_documents_->emplace(hasher.Get(), document_id);
+    }
+    
     const double inv_word_count = 1.0 / words.size();
-    for (const std::string& word : words) {
-        word_to_document_freqs_[word][document_id] += inv_word_count;
+    auto& word_freqs = document_to_word_freqs_[document_id];
+    for (const std::string_view word : words) {
+        //сервер хранит единственную копию каждого слова, на неё ссылаются все string_view индекса
+        auto it = word_to_term_id_.lower_bound(word);
+        if (it == word_to_term_id_.end() || it->first != word) {
+            it = word_to_term_id_.emplace_hint(it, word, postings_.size());
+            postings_.emplace_back();
+        }
+        postings_[it->second].Add(document_id, inv_word_count);
+        word_freqs[it->first] += inv_word_count;
     }
     
-    documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status});
-    document_ids_.push_back(document_id);
+    AddDocumentData(document_id, DocumentData{ComputeAverageRating(ratings), status});
+    ++epoch_;
 }
 
-std::vector<std::string> SearchServer::ParseDocument(const std::string& text) const {
-    std::vector<std::string> words;
-    for (const std::string& word : SplitIntoWords(text)) {
+void SearchServer::Merge(const SearchServer& other) {
+    for (const auto& [document_id, _] : other.documents_) {
+        if (documents_.count(document_id) != 0) {
+            throw std::invalid_argument("document id "s + std::to_string(document_id) + " is invalid or already exists"s);
+        }
+    }
+    
+    for (const auto& [word, other_term_id] : other.word_to_term_id_) {
+        const PostingList& other_posting_list = other.postings_[other_term_id];
+        if (other_posting_list.size() == 0) {
+            continue;
+        }
+        auto it = word_to_term_id_.lower_bound(word);
+        if (it == word_to_term_id_.end() || it->first != word) {
+            it = word_to_term_id_.emplace_hint(it, word, postings_.size());
+            postings_.emplace_back();
+        }
+        postings_[it->second].Merge(other_posting_list);
+    }
+    
+    //ключи прямого индекса переводятся на строки своего словаря
+    for (const auto& [document_id, _] : other.documents_) {
+        auto& word_freqs = document_to_word_freqs_[document_id];
+        for (const auto& [word, term_freq] : other.GetWordFrequencies(document_id)) {
+            word_freqs.emplace_hint(word_freqs.end(), word_to_term_id_.find(word)->first, term_freq);
+        }
+    }
+    for (const auto& [document_id, document_data] : other.documents_) {
+        AddDocumentData(document_id, document_data);
+    }
+    if (word_set_to_documents_) {
+        for (const auto& [document_id, _] : other.documents_) {
+            word_set_to_documents_->emplace(ComputeWordSetHash(document_id), document_id);
+        }
+    }
+    ++epoch_;
+}
+
+void SearchServer::AddDocuments(const std::vector<NewDocument>& documents) {
+    if (word_set_to_documents_) {
+        for (const NewDocument& document : documents) {
+            AddDocument(document.id, document.text, document.status, document.ratings);
+        }
+        return;
+    }
+    
+    //1. id и текст каждого документа проверяются параллельно; повтор id внутри пакета - ошибка у второго вхождения
+    std::vector<char> is_invalid(documents.size());
+    std::vector<size_t> by_id(documents.size());
+    std::iota(by_id.begin(), by_id.end(), 0);
+    std::sort(std::execution::par, by_id.begin(), by_id.end(), [&](size_t lhs, size_t rhs) {
+        return std::make_pair(documents[lhs].id, lhs) < std::make_pair(documents[rhs].id, rhs);
+    });
+    for (size_t i = 1; i < by_id.size(); ++i) {
+        if (documents[by_id[i]].id == documents[by_id[i - 1]].id) {
+            is_invalid[by_id[i]] = 1;
+        }
+    }
+    
+    //частоты слов документа, как в AddDocument: за каждое вхождение слова прибавляется 1 / число слов
+    std::vector<std::vector<std::pair<std::string_view, double>>> document_words(documents.size());
+    std::for_each(std::execution::par, by_id.begin(), by_id.end(), [&](size_t i) {
+        const NewDocument& document = documents[i];
+        if (is_invalid[i] || document.id < 0 || documents_.count(document.id) != 0) {
+            is_invalid[i] = 1;
+            return;
+        }
+        ScratchScope scope;
+        std::pmr::vector<std::string_view> words(ScratchScope::GetResource());
+        try {
+            words = ParseDocument(document.text, ScratchScope::GetResource());
+        } catch (const std::invalid_argument&) {
+            is_invalid[i] = 1;
+            return;
+        }
+        
+        std::sort(words.begin(), words.end());
+        const double inv_word_count = 1.0 / words.size();
+        for (size_t begin = 0, end = 0; begin < words.size(); begin = end) {
+            double term_freq = 0.0;
+            for (end = begin; end < words.size() && words[end] == words[begin]; ++end) {
+                term_freq += inv_word_count;
+            }
+            document_words[i].emplace_back(words[begin], term_freq);
+        }
+    });
+    
+    //добавляются документы до первого ошибочного; дальше они перебираются по возрастанию id
+    const size_t count = std::find(is_invalid.begin(), is_invalid.end(), 1) - is_invalid.begin();
+    by_id.erase(std::remove_if(by_id.begin(), by_id.end(), [=](size_t i) { return i >= count; }), by_id.end());
+    const auto chunks = SplitIntoChunks(count);
+    
+    //2. каждый кусок собирает свои постинги: документы идут по возрастанию id, поэтому списки сразу упорядочены
+    struct ChunkPostings {
+        std::unordered_map<std::string_view, size_t> word_to_slot;
+        std::vector<std::string_view> words;
+        std::vector<PostingList> posting_lists;
+        std::vector<size_t> term_ids;
+        std::vector<std::string_view> keys; //строки словаря сервера
+    };
+    std::vector<ChunkPostings> chunk_postings(chunks.size());
+    std::transform(std::execution::par, chunks.begin(), chunks.end(), chunk_postings.begin(), [&](const auto& chunk) {
+        ChunkPostings postings;
+        for (size_t k = chunk.first; k < chunk.second; ++k) {
+            const int document_id = documents[by_id[k]].id;
+            for (const auto& [word, term_freq] : document_words[by_id[k]]) {
+                const auto [it, is_new] = postings.word_to_slot.try_emplace(word, postings.words.size());
+                if (is_new) {
+                    postings.words.push_back(word);
+                    postings.posting_lists.emplace_back();
+                }
+                PostingList& posting_list = postings.posting_lists[it->second];
+                posting_list.document_ids.push_back(document_id);
+                posting_list.term_freqs.push_back(term_freq);
+                posting_list.max_term_freq = std::max(posting_list.max_term_freq, term_freq);
+            }
+        }
+        return postings;
+    });
+    
+    //3. словарь пополняется последовательно, но в нём ищется каждое различное слово куска, а не каждое вхождение
+    for (ChunkPostings& postings : chunk_postings) {
+        for (const std::string_view word : postings.words) {
+            auto it = word_to_term_id_.lower_bound(word);
+            if (it == word_to_term_id_.end() || it->first != word) {
+                it = word_to_term_id_.emplace_hint(it, word, postings_.size());
+                postings_.emplace_back();
+            }
+            postings.term_ids.push_back(it->second);
+            postings.keys.push_back(it->first);
+        }
+    }
+    
+    //4. списки кусков дописываются в индекс; куски идут по возрастанию id, поэтому у каждого слова достаточно склеить их по порядку.
+    //Слова разбиты на диапазоны term id, которые обрабатываются параллельно и не пересекаются
+    std::vector<std::vector<std::pair<size_t, const PostingList*>>> chunk_lists(chunks.size());
+    for (size_t c = 0; c < chunks.size(); ++c) {
+        for (size_t slot = 0; slot < chunk_postings[c].words.size(); ++slot) {
+            chunk_lists[c].emplace_back(chunk_postings[c].term_ids[slot], &chunk_postings[c].posting_lists[slot]);
+        }
+        std::sort(chunk_lists[c].begin(), chunk_lists[c].end());
+    }
+    const auto term_ranges = SplitIntoChunks(postings_.size());
+    std::for_each(std::execution::par, term_ranges.begin(), term_ranges.end(), [&](const auto& term_range) {
+        std::vector<std::pair<size_t, size_t>> cursors;
+        for (const auto& lists : chunk_lists) {
+            auto by_term = [](const auto& list, size_t term_id) { return list.first < term_id; };
+            const size_t begin = std::lower_bound(lists.begin(), lists.end(), term_range.first, by_term) - lists.begin();
+            const size_t end = std::lower_bound(lists.begin(), lists.end(), term_range.second, by_term) - lists.begin();
+            cursors.emplace_back(begin, end);
+        }
+        
+        PostingList posting_list;
+        for (size_t term_id = term_range.first; term_id < term_range.second; ++term_id) {
+            posting_list = {};
+            for (size_t c = 0; c < cursors.size(); ++c) {
+                auto& [cursor, end] = cursors[c];
+                if (cursor != end && chunk_lists[c][cursor].first == term_id) {
+                    const PostingList& chunk_list = *chunk_lists[c][cursor++].second;
+                    posting_list.document_ids.insert(posting_list.document_ids.end(), chunk_list.document_ids.begin(), chunk_list.document_ids.end());
+                    posting_list.term_freqs.insert(posting_list.term_freqs.end(), chunk_list.term_freqs.begin(), chunk_list.term_freqs.end());
+                    posting_list.max_term_freq = std::max(posting_list.max_term_freq, chunk_list.max_term_freq);
+                }
+            }
+            if (!posting_list.document_ids.empty()) {
+                postings_[term_id].Merge(posting_list);
+            }
+        }
+    });
+    
+    //5. прямой индекс: словари документов заполняются параллельно и затем вставляются по возрастанию id
+    //словари сразу создаются на ресурсе сервера, чтобы затем переместиться в индекс без копирования
+    std::pmr::vector<WordFrequencies> word_freqs(by_id.size(), document_to_word_freqs_.get_allocator().resource());
+    std::for_each(std::execution::par, chunk_postings.begin(), chunk_postings.end(), [&](const ChunkPostings& postings) {
+        const auto& chunk = chunks[&postings - chunk_postings.data()];
+        for (size_t k = chunk.first; k < chunk.second; ++k) {
+            for (const auto& [word, term_freq] : document_words[by_id[k]]) {
+                word_freqs[k].emplace_hint(word_freqs[k].end(), postings.keys[postings.word_to_slot.at(word)], term_freq);
+            }
+        }
+    });
+    for (size_t k = 0; k < by_id.size(); ++k) {
+        const NewDocument& document = documents[by_id[k]];
+        document_to_word_freqs_.emplace_hint(document_to_word_freqs_.end(), document.id, std::move(word_freqs[k]));
+        AddDocumentData(document.id, DocumentData{ComputeAverageRating(document.ratings), document.status});
+    }
+    ++epoch_;
+    
+    //первый ошибочный документ добавляется обычным путём, чтобы исключение было ровно тем же, что у AddDocument
+    if (count < documents.size()) {
+        const NewDocument& document = documents[count];
+        AddDocument(document.id, document.text, document.status, document.ratings);
+    }
+}
+
+void SearchServer::AddDocuments(std::istream& input) {
+    auto read_lines = [&input]() {
+        std::vector<std::string> lines;
+        std::string line;
+        while (lines.size() < BULK_BATCH_SIZE && std::getline(input, line)) {
+            lines.push_back(std::move(line));
+        }
+        return lines;
+    };
+    
+    size_t line_number = 0;
+    std::vector<std::string> lines = read_lines();
+    while (!lines.empty()) {
+        std::future<std::vector<std::string>> next_lines = std::async(std::launch::async, read_lines);
+        
+        //строки до ошибки формата добавляются, как если бы документы шли по одному
+        std::vector<NewDocument> documents;
+        std::string format_error;
+        for (const std::string& line : lines) {
+            ++line_number;
+            if (line.empty()) {
+                continue;
+            }
+            try {
+                documents.push_back(ParseDocumentLine(line));
+            } catch (const std::invalid_argument& error) {
+                format_error = "line "s + std::to_string(line_number) + ": "s + error.what();
+                break;
+            }
+        }
+        AddDocuments(documents);
+        if (!format_error.empty()) {
+            throw std::invalid_argument(format_error);
+        }
+        lines = next_lines.get();
+    }
+}
+
+void SearchServer::RemoveDocument(int document_id) {
+    RemoveDocument(std::execution::seq, document_id);
+}
+
+void SearchServer::RemoveDocument(const std::execution::sequenced_policy&, int document_id) {
+    if (documents_.count(document_id) == 0) {
+        return;
+    }
+    UnindexWordSet(document_id);
+    
+    ForEachDocumentWord(document_id, [&](std::string_view word) {
+        GetPostingList(word).Remove(document_id);
+    });
+    
+    RemoveWordFrequencies(document_id);
+    RemoveDocumentData(document_id);
+    ++epoch_;
+}
+
+void SearchServer::RemoveDocument(const std::execution::parallel_policy&, int document_id) {
+    if (documents_.count(document_id) == 0) {
+        return;
+    }
+    UnindexWordSet(document_id);
+    
+    //у каждого слова документа свой список постингов, поэтому потоки не пересекаются
+    std::vector<PostingList*> posting_lists;
+    ForEachDocumentWord(document_id, [&](std::string_view word) {
+        posting_lists.push_back(&GetPostingList(word));
+    });
+    std::for_each(std::execution::par, posting_lists.begin(), posting_lists.end(), [&](PostingList* posting_list) {
+        posting_list->Remove(document_id);
+    });
+    
+    RemoveWordFrequencies(document_id);
+    RemoveDocumentData(document_id);
+    ++epoch_;
+}
+
+void SearchServer::RemoveWordFrequencies(int document_id) {
+    document_to_word_freqs_.erase(document_id);
+    std::lock_guard guard(mapped_word_freqs_->mutex);
+    mapped_word_freqs_->documents.erase(document_id);
+}
+
+std::pmr::vector<std::string_view> SearchServer::ParseDocument(std::string_view text, std::pmr::memory_resource* resource) const {
+    std::pmr::vector<std::string_view> words(resource);
+    for (const std::string_view word : SplitIntoWordsView(text, resource)) {
         if (!IsValidWord(word)) {
-            throw std::invalid_argument("invalid word "s + word + " was passed to document"s);
+            throw std::invalid_argument("invalid word "s + std::string(word) + " was passed to document"s);
         }
         if (!IsStopWord(word)) {
             words.push_back(word);
@@ -69,63 +1113,170 @@ std::vector<std::string> SearchServer::ParseDocument(const std::string& text) co
     return words;
 }
 
-std::vector<Document> SearchServer::FindTopDocuments(const std::string& raw_query, DocumentStatus sought_status) const {
-    return FindTopDocuments(raw_query, [=](int document_id, DocumentStatus status, int rating) {
-                                           return status == sought_status;
-                                       });
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus sought_status, size_t top_count) const {
+    return FindTopDocuments(std::execution::seq, raw_query, sought_status, top_count);
+}
+
+std::vector<Document> SearchServer::FindNextPage(std::string_view raw_query, DocumentStatus sought_status, size_t page_size,
+                                                 PageCursor& cursor) const {
+    return FindNextPage(std::execution::seq, raw_query, StatusPredicate{sought_status}, page_size, cursor);
+}
+
+void SearchServer::EnableQueryCache(size_t capacity) {
+    query_cache_ = capacity ? std::make_unique<QueryCache>(capacity) : nullptr;
 }
 
-std::tuple<std::vector<std::string>, DocumentStatus> SearchServer::MatchDocument(const std::string& raw_query, int document_id) const {
-    Query query = ParseQuery(raw_query);
+QueryCacheStats SearchServer::GetQueryCacheStats() const {
+    return query_cache_ ? query_cache_->GetStats() : QueryCacheStats{};
+}
+
+std::string SearchServer::MakeQueryCacheKey(const Query& query, DocumentStatus sought_status, size_t top_count) {
+    //в словах не бывает управляющих символов, поэтому '\n' надёжно разделяет части ключа
+    std::string key;
+    for (const std::string_view word : query.plus_words) {
+        key += word;
+        key += ' ';
+    }
+    key += '\n';
+    for (const std::string_view word : query.minus_words) {
+        key += word;
+        key += ' ';
+    }
+    key += '\n';
+    key += std::to_string(static_cast<int>(sought_status));
+    key += '\n';
+    key += std::to_string(top_count);
+    return key;
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::string_view raw_query, int document_id) const {
+    return MatchDocument(std::execution::seq, raw_query, document_id);
+}
+
+template <typename Stats>
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchQuery(std::string_view raw_query, int document_id, Stats& stats) const {
+    ScratchScope scope;
+    const Query query = ParseQuery(raw_query, stats);
+    const DocumentStatus status = documents_.at(document_id).status;
     
-    std::vector<std::string> matched_words;
-    for (const std::string& word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+    bool is_excluded;
+    {
+        QueryPhaseTimer timer(stats, &QueryStats::minus_filter_time);
+        is_excluded = std::any_of(query.minus_words.begin(), query.minus_words.end(), [&](std::string_view word) {
+            return ContainsQueryWord(word, query.FindPrefixLastWord(word), document_id, stats);
+        });
+    }
+    if (is_excluded) {
+        return {std::vector<std::string_view>{}, status};
+    }
+    
+    QueryPhaseTimer timer(stats, &QueryStats::scoring_time);
+    std::vector<std::string_view> matched_words;
+    for (const std::string_view word : query.plus_words) {
+        if (IsPrefixWord(word)) {
+            if (ContainsQueryWord(word, query.FindPrefixLastWord(word), document_id, stats)) {
+                matched_words.push_back(word);
+            }
+            continue;
+        }
+        const auto it = word_to_term_id_.find(GetExactWord(word));
+        if (it == word_to_term_id_.end()) {
             continue;
         }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            matched_words.push_back(word);
+        if constexpr (Stats::enabled) {
+            ++stats.postings_scanned;
+        }
+        if (postings_[it->second].Contains(document_id)) {
+            matched_words.push_back(it->first);
         }
     }
+    return {std::move(matched_words), status};
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::sequenced_policy&, std::string_view raw_query, int document_id) const {
+    NoQueryStats stats;
+    return MatchQuery(raw_query, document_id, stats);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::string_view raw_query, int document_id, QueryStats& stats) const {
+    stats = {};
+    auto result = MatchQuery(raw_query, document_id, stats);
+    stats.result_count = std::get<0>(result).size();
+    query_metrics_->Record(stats);
+    return result;
+}
+
+void SearchServer::WriteQueryMetrics(std::ostream& out) const {
+    query_metrics_->WritePrometheus(out);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::parallel_policy&, std::string_view raw_query, int document_id) const {
+    ScratchScope scope;
+    const Query query = ParseQuery(raw_query, ScratchScope::GetResource());
+    const DocumentStatus status = documents_.at(document_id).status;
     
-    for (const std::string& word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+    NoQueryStats stats;
+    if (std::any_of(std::execution::par, query.minus_words.begin(), query.minus_words.end(), [&](std::string_view word) {
+            return ContainsQueryWord(word, query.FindPrefixLastWord(word), document_id, stats);
+        })) {
+        return {std::vector<std::string_view>{}, status};
+    }
+    
+    //найденные слова подменяются ссылками на словарь сервера, пустые ссылки потом выбрасываются;
+    //transform сохраняет порядок, поэтому результат совпадает с последовательной версией
+    std::vector<std::string_view> matched_words(query.plus_words.size());
+    std::transform(std::execution::par, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(), [&](std::string_view word) {
+        if (IsPrefixWord(word)) {
+            return ContainsQueryWord(word, query.FindPrefixLastWord(word), document_id, stats) ? word : std::string_view();
         }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            matched_words.clear();
-            break;
+        const auto it = word_to_term_id_.find(GetExactWord(word));
+        if (it != word_to_term_id_.end() && postings_[it->second].Contains(document_id)) {
+            return std::string_view(it->first);
         }
-    }
-    return {matched_words, documents_.at(document_id).status};
+        return std::string_view();
+    });
+    matched_words.erase(std::remove(matched_words.begin(), matched_words.end(), std::string_view()), matched_words.end());
+    
+    return {std::move(matched_words), status};
 }
 
-SearchServer::Query SearchServer::ParseQuery(const std::string& text) const {
-    Query query;
-    for (const std::string& word : SplitIntoWords(text)) {
+SearchServer::Query SearchServer::ParseQuery(std::string_view text) const {
+    return ParseQuery(text, std::pmr::get_default_resource());
+}
+
+SearchServer::Query SearchServer::ParseQuery(std::string_view text, std::pmr::memory_resource* resource) const {
+    Query query(resource);
+    for (const std::string_view word : SplitIntoWordsView(text, resource)) {
         const QueryWord query_word = ParseQueryWord(word);
         if (!query_word.is_stop) {
             if (query_word.is_minus) {
-                query.minus_words.insert(query_word.data);
+                query.minus_words.push_back(query_word.data);
             } else {
-                query.plus_words.insert(query_word.data);
+                query.plus_words.push_back(query_word.data);
             }
         }
     }
+    
+    for (auto* words : {&query.plus_words, &query.minus_words}) {
+        std::sort(words->begin(), words->end());
+        words->erase(std::unique(words->begin(), words->end()), words->end());
+    }
     return query;
 }
 
-SearchServer::QueryWord SearchServer::ParseQueryWord(std::string text) const {
+SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) const {
     bool is_minus = false;
     if (text[0] == '-') {
         is_minus = true;
-        text = text.substr(1);
+        text.remove_prefix(1);
     }
     
     //если после отрубания минуса осталась пустота или ещё один минус или слово содержит спецсимволы
     if (text.empty() || text[0] == '-' || !IsValidWord(text)) {
-        throw std::invalid_argument("invalid word "s + text + " was passed to query"s);
+        throw std::invalid_argument("invalid word "s + std::string(text) + " was passed to query"s);
     }
     
-    return {text, is_minus, IsStopWord(text)};
+    //Префикс и экранированное слово остаются в запросе со звёздочками, чтобы не смешиваться с точным словом;
+    //префикс стоп-словом не бывает
+    return {text, is_minus, !IsPrefixWord(text) && IsStopWord(GetExactWord(text))};
 }
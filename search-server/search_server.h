@@ -1,42 +1,234 @@
 #pragma once
 
+#include "cancellation_token.h"
+#include "compressed_postings.h"
+#include "concurrent_map.h"
 #include "document.h"
+#include "document_bitmap.h"
+#include "query_cache.h"
+#include "query_stats.h"
+#include "scratch_arena.h"
+#include "snapshot.h"
 #include "string_processing.h"
+#include "term_dictionary.h"
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <execution>
+#include <istream>
+#include <limits>
 #include <map>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <ostream>
 #include <set>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 const double EPSILON = 1e-6;
+const size_t RELEVANCE_MAP_BUCKET_COUNT = 64;
+const size_t BULK_BATCH_SIZE = 1 << 16;
+const size_t MIN_COMPRESSED_POSTING_COUNT = 16; //более короткий список сжатием не окупить: заголовки займут больше, чем сэкономится
+//Слово запроса со звёздочкой в конце, как cat*, - префикс: он ищется как одно слово, в которое входят первые по алфавиту
+//MAX_PREFIX_EXPANSION_COUNT слов индекса с этим началом. Частота префикса в документе - сумма частот его слов, idf - по числу
+//документов хотя бы с одним из них. Удвоенная звёздочка в конце ищет слово со звёздочкой: cat** - это слово cat*.
+//Одиночная звёздочка - обычное слово, префикс из неё был бы пустым. Поиск составных индексов раскрывает префикс
+//до первых MAX_PREFIX_EXPANSION_COUNT слов всех частей вместе (см. BoundPrefixExpansions), а MatchDocument -
+//только в части с документом, так что найденное им слово может не войти в раскрытие поиска
+const size_t MAX_PREFIX_EXPANSION_COUNT = 64;
+
+//документ для пакетного добавления; текст не копируется и должен жить до конца AddDocuments
+struct NewDocument {
+    int id = 0;
+    std::string_view text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
+
+//выдача поиска со сроком; is_partial - поиск прерван по сроку или отмене, и в выдаче лучшие из найденных к этому моменту документов
+struct SearchResult {
+    std::vector<Document> documents;
+    bool is_partial = false;
+};
 
 class SearchServer {
 public:
+    //Узлы словаря, прямого индекса и списков документов берутся у resource. AddDocuments заполняет прямой индекс
+    //из нескольких потоков, поэтому для него ресурс должен быть потокобезопасным, как synchronized_pool_resource
     template <typename StringContainer>
-    explicit SearchServer(const StringContainer& stop_words) : stop_words_(ParseStopWords(stop_words)) {}
-    explicit SearchServer(const std::string &stop_words) : SearchServer(SplitIntoWords(stop_words)) {}
-    explicit SearchServer(std::string_view stop_words) : SearchServer(SplitIntoWordsView(stop_words)) {}
+    explicit SearchServer(const StringContainer& stop_words, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : stop_words_(ParseStopWords(stop_words)),
+          word_to_term_id_(resource),
+          document_to_word_freqs_(resource),
+          mapped_word_freqs_(std::make_unique<WordFrequenciesCache>(resource)),
+          documents_(resource),
+          document_ids_(resource) {}
+    explicit SearchServer(const std::string &stop_words, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : SearchServer(SplitIntoWords(stop_words), resource) {}
+    explicit SearchServer(std::string_view stop_words, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : SearchServer(SplitIntoWordsView(stop_words), resource) {}
+    //восстанавливает индекс из снимка, сделанного SaveSnapshot; документы заново не разбираются
+    explicit SearchServer(SnapshotReader& snapshot, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    
+    void SaveSnapshot(const std::string& path) const;
     
-    const std::set<std::string>& GetStopWords() const;
+    const std::set<std::string, std::less<>>& GetStopWords() const;
     size_t GetDocumentCount() const;
-    int GetDocumentId(uint n) const;
     
-    void AddDocument(int document_id, const std::string& document, DocumentStatus status, const std::vector<int>& ratings);
+    std::pmr::set<int>::const_iterator begin() const;
+    std::pmr::set<int>::const_iterator end() const;
+    
+    using WordFrequencies = std::pmr::map<std::string_view, double>;
+    const WordFrequencies& GetWordFrequencies(int document_id) const;
+    
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    //Пакетное добавление: документы разбираются параллельно и вливаются в индекс разом. Ошибки те же, что у AddDocument,
+    //и проверяются по порядку: документы до первого ошибочного добавляются, он и следующие за ним - нет
+    void AddDocuments(const std::vector<NewDocument>& documents);
+    //по документу на строку: id, статус (ACTUAL, IRRELEVANT, BANNED, REMOVED), рейтинги через пробел и текст,
+    //поля разделены табуляцией; следующая пачка из BULK_BATCH_SIZE строк читается, пока обрабатывается текущая
+    void AddDocuments(std::istream& input);
+    
+    //В режиме пропуска дубликатов AddDocument молча не добавляет документ с тем же набором слов, что у уже добавленного,
+    //а если у нового id меньше - заменяет им старый, так что остаётся меньший id, как после RemoveDuplicates.
+    //Документы, добавленные до включения режима, между собой не сверяются; пакеты в этом режиме добавляются по одному документу
+    void SetSkipDuplicates(bool skip);
+    
+    //Сжимает все списки постингов: поиск читает их поблочно, не распаковывая целиком, а результаты не меняются.
+    //Добавление и удаление документа распаковывают списки его слов, поэтому сжимать стоит индекс, который почти не меняется
+    void CompressPostings();
+    //байты, занятые списками постингов
+    size_t GetPostingsMemoryUsage() const;
+    
+    void RemoveDocument(int document_id);
+    void RemoveDocument(const std::execution::sequenced_policy&, int document_id);
+    void RemoveDocument(const std::execution::parallel_policy&, int document_id);
+    
+    //кэш результатов запросов с фильтром по статусу; capacity == 0 отключает кэш
+    void EnableQueryCache(size_t capacity);
+    QueryCacheStats GetQueryCacheStats() const;
     
     template <typename DocumentPredicate>
-    std::vector<Document> FindTopDocuments(const std::string& raw_query, DocumentPredicate predicate) const;
-    std::vector<Document> FindTopDocuments(const std::string& raw_query, DocumentStatus sought_status = DocumentStatus::ACTUAL) const;
-    std::tuple<std::vector<std::string>, DocumentStatus> MatchDocument(const std::string& raw_query, int document_id) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate predicate,
+                                           size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate predicate,
+                                           size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus sought_status = DocumentStatus::ACTUAL,
+                                           size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus sought_status = DocumentStatus::ACTUAL,
+                                           size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    
+    //то же со статистикой: stats заполняется заново и добавляется в сводные метрики сервера
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate predicate,
+                                           size_t top_count, QueryStats& stats) const;
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus sought_status,
+                                           size_t top_count, QueryStats& stats) const;
     
+    //Поиск со сроком: перебор постингов между блоками сверяется со сроком и отменой и, если время вышло или запрос отменён,
+    //прекращается. Кэш запросов при этом не используется, чтобы неполная выдача не попала в него
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    SearchResult FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate predicate, size_t top_count,
+                                  std::chrono::steady_clock::time_point deadline, const CancellationToken& token = {}) const;
+    template <typename ExecutionPolicy>
+    SearchResult FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus sought_status, size_t top_count,
+                                  std::chrono::steady_clock::time_point deadline, const CancellationToken& token = {}) const;
+    
+    //Позиция в выдаче запроса для постраничного обхода. Хранит последний выданный документ, и следующая страница
+    //ищется как лучшие документы, идущие в порядке IsMoreRelevant после него, - без пересчёта предыдущих страниц.
+    //Если индекс меняется между страницами, обход продолжается от той же границы по новой релевантности
+    class PageCursor {
+    public:
+        //последняя страница оказалась неполной, дальше документов нет
+        bool IsExhausted() const { return is_exhausted_; }
+    
+    private:
+        friend class SearchServer;
+        
+        bool has_last_document_ = false;
+        Document last_document_;
+        bool is_exhausted_ = false;
+    };
+    
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindNextPage(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate predicate, size_t page_size,
+                                       PageCursor& cursor) const;
+    std::vector<Document> FindNextPage(std::string_view raw_query, DocumentStatus sought_status, size_t page_size, PageCursor& cursor) const;
+    
+    //найденные слова ссылаются на словарь сервера и действительны, пока слово есть в индексе; префиксы - на текст запроса
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::sequenced_policy&, std::string_view raw_query, int document_id) const;
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::parallel_policy&, std::string_view raw_query, int document_id) const;
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id, QueryStats& stats) const;
+    
+    //сводные метрики запросов со статистикой в текстовом формате Prometheus
+    void WriteQueryMetrics(std::ostream& out) const;
+    
+    //слова ссылаются на текст запроса, отсортированы и без повторов
     struct Query {
-        std::set<std::string> plus_words;
-        std::set<std::string> minus_words;
+        std::pmr::vector<std::string_view> plus_words;
+        std::pmr::vector<std::string_view> minus_words;
+        std::pmr::vector<double> plus_word_idfs; //idf плюс-слов по составному индексу; если пусто, idf считается по документам сервера
+        //Границы префиксов по составному индексу: префикс prefix_words[i] раскрывается только до слова prefix_last_words[i]
+        //включительно. prefix_words отсортированы; префикс без границы раскрывается по словам сервера
+        std::pmr::vector<std::string_view> prefix_words;
+        std::vector<std::string> prefix_last_words;
+        
+        Query() = default;
+        explicit Query(std::pmr::memory_resource* resource)
+            : plus_words(resource), minus_words(resource), plus_word_idfs(resource), prefix_words(resource) {}
+        
+        //граница префикса word; пустая, если её нет
+        std::string_view FindPrefixLastWord(std::string_view word) const;
+    };
+    
+    //Для индексов, составленных из нескольких серверов: разбор запроса, статистика слов и поиск по разобранному запросу,
+    //в который можно заранее положить idf, посчитанные по всем частям сразу
+    Query ParseQuery(std::string_view text) const;
+    bool HasDocument(int document_id) const;
+    size_t GetDocumentFrequency(std::string_view word, std::string_view prefix_last_word = {}) const;
+    //префиксы запроса, плюс- и минус-слова вместе, по возрастанию без повторов
+    static std::vector<std::string_view> GetPrefixWords(const Query& query);
+    //для каждого из GetPrefixWords(query) - первые MAX_PREFIX_EXPANSION_COUNT непустых слов сервера с этим началом
+    std::vector<std::vector<std::string>> GetPrefixExpansions(const Query& query) const;
+    //Кладёт в query границы префиксов по раскрытиям GetPrefixExpansions всех частей индекса: первые
+    //MAX_PREFIX_EXPANSION_COUNT слов индекса целиком входят в объединение первых слов частей, так что граница -
+    //последнее из первых MAX_PREFIX_EXPANSION_COUNT слов объединения, и все части раскрывают префикс одинаково
+    static void BoundPrefixExpansions(Query& query, const std::vector<std::vector<std::vector<std::string>>>& part_expansions);
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindQueryTopDocuments(ExecutionPolicy&& policy, const Query& query, DocumentPredicate predicate, size_t top_count) const {
+        NoQueryStats stats;
+        return FindQueryTopDocuments(policy, query, predicate, top_count, stats);
+    }
+    //переносит документы other вместе с постингами, не разбирая их заново; id документов не должны пересекаться
+    void Merge(const SearchServer& other);
+    
+    //порядок выдачи: по убыванию релевантности, при почти равной - по убыванию рейтинга, затем по возрастанию id
+    static bool IsMoreRelevant(const Document& lhs, const Document& rhs);
+    
+    //Отбор по статусу. Поиск узнаёт этот предикат по типу и проверяет документ по битовой карте статуса,
+    //не обращаясь к его данным; любой другой предикат по-прежнему вызывается для каждого документа
+    struct StatusPredicate {
+        DocumentStatus status;
+        
+        bool operator()(int, DocumentStatus document_status, int) const {
+            return document_status == status;
+        }
     };
     
     struct QueryWord {
-        std::string data;
+        std::string_view data;
         bool is_minus;
         bool is_stop;
     };
@@ -47,88 +239,707 @@ private:
         DocumentStatus status;
     };
     
-    const std::set<std::string> stop_words_;
-    std::map<std::string, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, DocumentData> documents_;
-    std::vector<int> document_ids_;
+    //Срок и отмена одного запроса. Решение остановиться запоминается, чтобы его сразу увидели все потоки поиска,
+    //а IsStopped потом отличал прерванный поиск от закончившегося вовремя
+    class QueryBudget {
+    public:
+        QueryBudget(std::chrono::steady_clock::time_point deadline, const CancellationToken& token) : deadline_(deadline), token_(token) {}
+        
+        bool ShouldStop() const {
+            if (is_stopped_.load(std::memory_order_relaxed)) {
+                return true;
+            }
+            if (token_.IsCancelled() || std::chrono::steady_clock::now() >= deadline_) {
+                is_stopped_.store(true, std::memory_order_relaxed);
+                return true;
+            }
+            return false;
+        }
+        bool IsStopped() const { return is_stopped_.load(std::memory_order_relaxed); }
+    
+    private:
+        const std::chrono::steady_clock::time_point deadline_;
+        const CancellationToken& token_;
+        mutable std::atomic<bool> is_stopped_{false};
+    };
+    
+    //постинги одного слова: id документов по возрастанию и параллельный им массив частот
+    //удалённый документ помечается нулевой частотой, а массивы уплотняются, когда таких пометок становится больше половины.
+    //Сжатый список хранится в compressed, а массивы пусты; изменение сначала распаковывает его обратно.
+    //Список из снимка читается прямо из отображённого файла через mapped_*, а собственные массивы пусты; изменение сначала
+    //копирует его к себе
+    struct PostingList {
+        std::vector<int> document_ids;
+        std::vector<double> term_freqs;
+        std::unique_ptr<const CompressedPostingList> compressed; //по указателю, чтобы несжатые списки редких слов не росли
+        const int* mapped_document_ids = nullptr;
+        const double* mapped_term_freqs = nullptr;
+        size_t mapped_count = 0;
+        double max_term_freq = 0.0; //вместе с idf даёт верхнюю оценку вклада слова в релевантность
+        size_t removed_count = 0;
+        
+        //несжатые постинги: свои массивы или массивы снимка
+        const int* GetDocumentIds() const { return mapped_document_ids ? mapped_document_ids : document_ids.data(); }
+        const double* GetTermFreqs() const { return mapped_document_ids ? mapped_term_freqs : term_freqs.data(); }
+        size_t GetStoredCount() const { return mapped_document_ids ? mapped_count : document_ids.size(); }
+        
+        size_t size() const { return compressed ? compressed->size() : GetStoredCount() - removed_count; }
+        size_t GetMemoryUsage() const; //массивы снимка лежат в файле и не считаются
+        bool Contains(int document_id) const;
+        double FindTermFreq(int document_id) const; //0.0, если документа в списке нет
+        void Add(int document_id, double term_freq);
+        void Remove(int document_id);
+        void Merge(const PostingList& other); //списки сливаются за линейное время, пометки удаления при этом выбрасываются
+        void Compress();
+        void Decompress();
+        void MakeOwned(); //распаковывает сжатый список или копирует список снимка в свои массивы
+        
+        template <typename Function>
+        void ForEach(Function function) const {
+            ForEachUntil(function, []() {
+                return false;
+            });
+        }
+        //is_stopped() спрашивается перед каждыми POSTING_BLOCK_SIZE постингами, как перед блоком сжатого списка
+        template <typename Function, typename StopPredicate>
+        void ForEachUntil(Function function, StopPredicate is_stopped) const {
+            if (compressed) {
+                compressed->ForEachUntil(function, is_stopped);
+                return;
+            }
+            const int* ids = GetDocumentIds();
+            const double* freqs = GetTermFreqs();
+            const size_t count = GetStoredCount();
+            for (size_t i = 0; i < count; ++i) {
+                if (i % POSTING_BLOCK_SIZE == 0 && is_stopped()) {
+                    return;
+                }
+                if (freqs[i] != 0.0) {
+                    function(ids[i], freqs[i]);
+                }
+            }
+        }
+        
+        //живые постинги по возрастанию id в любом из двух представлений
+        class Cursor {
+        public:
+            explicit Cursor(const PostingList& posting_list);
+            
+            bool IsExhausted() const {
+                return compressed_ ? compressed_->IsExhausted() : pos_ == count_;
+            }
+            int CurrentId() const {
+                return compressed_ ? compressed_->CurrentId() : document_ids_[pos_];
+            }
+            double CurrentTermFreq() const {
+                return compressed_ ? compressed_->CurrentTermFreq() : term_freqs_[pos_];
+            }
+            void Next();
+            void SeekTo(int document_id);
+        
+        private:
+            void SkipRemoved();
+            
+            const int* document_ids_ = nullptr;
+            const double* term_freqs_ = nullptr;
+            size_t count_ = 0;
+            size_t pos_ = 0;
+            std::unique_ptr<CompressedPostingList::Cursor> compressed_;
+        };
+    };
+    
+    const std::set<std::string, std::less<>> stop_words_;
+    std::pmr::map<std::string, size_t, std::less<>> word_to_term_id_;
+    std::vector<PostingList> postings_; //индекс - term id
+    std::pmr::map<int, WordFrequencies> document_to_word_freqs_; //ключи ссылаются на строки word_to_term_id_
     
-    static bool IsValidWord(const std::string& word);
-    bool IsStopWord(const std::string& word) const;
+    //Прямой индекс документов, загруженных из снимка, читается прямо из файла: у каждого документа отрезок term id его слов
+    //по возрастанию, а частоты берутся из списков постингов. Документ, добавленный после загрузки под тем же id,
+    //лежит в document_to_word_freqs_ и заслоняет запись снимка
+    struct MappedForwardIndex {
+        std::shared_ptr<const SnapshotMapping> mapping; //держит файл, пока из него читаются и постинги, и прямой индекс
+        const int* document_ids = nullptr;
+        size_t document_count = 0;
+        const uint64_t* word_offsets = nullptr;
+        const uint32_t* term_ids = nullptr;
+        std::vector<std::string_view> terms; //слово по term id; строки - ключи word_to_term_id_
+    };
+    MappedForwardIndex mapped_forward_index_;
+    //Карты частот документов из снимка, которые GetWordFrequencies строит при первом обращении. Мьютекс нужен, потому что
+    //строят их константные вызовы; лежит за указателем, чтобы сервер оставался перемещаемым
+    struct WordFrequenciesCache {
+        explicit WordFrequenciesCache(std::pmr::memory_resource* resource) : documents(resource) {}
+        
+        std::mutex mutex;
+        std::pmr::map<int, WordFrequencies> documents;
+    };
+    std::unique_ptr<WordFrequenciesCache> mapped_word_freqs_;
+    std::pmr::map<int, DocumentData> documents_;
+    std::pmr::set<int> document_ids_;
+    std::array<DocumentBitmap, 4> status_documents_; //id документов для каждого DocumentStatus
+    
+    std::unique_ptr<QueryCache> query_cache_;
+    uint64_t epoch_ = 0; //растёт при каждом изменении индекса, чтобы кэш не отдавал устаревшие результаты
+    std::unique_ptr<QueryMetrics> query_metrics_ = std::make_unique<QueryMetrics>();
+    std::unique_ptr<std::unordered_multimap<uint64_t, int>> word_set_to_documents_; //есть, только когда включён пропуск дубликатов
+    
+    //Словарь для раскрытия префиксов строится по word_to_term_id_ при первом префиксном запросе после появления новых слов.
+    //Мьютекс нужен, потому что строят его параллельные запросы; лежит за указателем, чтобы сервер оставался перемещаемым
+    struct TermDictionaryCache {
+        std::mutex mutex;
+        std::unique_ptr<const TermDictionary> dictionary;
+    };
+    std::unique_ptr<TermDictionaryCache> term_dictionary_ = std::make_unique<TermDictionaryCache>();
+    
+    static bool IsValidWord(std::string_view word);
+    bool IsStopWord(std::string_view word) const;
+    
+    const PostingList* FindPostingList(std::string_view word) const;
+    PostingList& GetPostingList(std::string_view word);
+    
+    static bool IsPrefixWord(std::string_view word);
+    static std::string_view GetExactWord(std::string_view word); //слово индекса для непрефиксного слова запроса
+    const TermDictionary& GetTermDictionary() const;
+    //function(word, posting_list) для первых MAX_PREFIX_EXPANSION_COUNT непустых слов префикса, не дальше last_word, если она задана
+    template <typename Function>
+    void ForEachPrefixExpansion(std::string_view prefix_word, std::string_view last_word, Function function) const;
+    //function(posting_list) для непустых списков слова запроса: у префикса - для каждого из раскрытых слов.
+    //prefix_last_word - граница префикса из Query::FindPrefixLastWord
+    template <typename Function>
+    void ForEachQueryPostingList(std::string_view word, std::string_view prefix_last_word, Function function) const;
+    //Постинги слова запроса как одного слова. Списки слов префикса объединяются в storage слиянием по окнам id,
+    //если слово одно, возвращается его список; nullptr, если постингов нет. Если budget велит остановиться,
+    //объединение обрывается и список остаётся неполным
+    const PostingList* FindQueryPostingList(std::string_view word, std::string_view prefix_last_word, PostingList& storage,
+                                            const QueryBudget* budget = nullptr) const;
+    template <typename Stats>
+    bool ContainsQueryWord(std::string_view word, std::string_view prefix_last_word, int document_id, Stats& stats) const;
+    
+    //term id слов документа из прямого индекса снимка; пустой отрезок, если в снимке документа нет.
+    //Удалён ли документ и не заслонён ли он новым, проверяет вызывающий
+    std::pair<const uint32_t*, const uint32_t*> FindMappedDocumentWords(int document_id) const;
+    //function(word) для слов живого документа по возрастанию, в каком бы прямом индексе он ни лежал
+    template <typename Function>
+    void ForEachDocumentWord(int document_id, Function function) const;
     
     static int ComputeAverageRating(const std::vector<int>& ratings);
-    double ComputeWordInverseDocumentFreq(const std::string& word) const;
+    uint64_t ComputeWordSetHash(int document_id) const;
+    void UnindexWordSet(int document_id);
+    double ComputeWordInverseDocumentFreq(const Query& query, size_t word_index, const PostingList& posting_list) const;
+    //documents_, document_ids_ и карты статусов меняются только вместе
+    void AddDocumentData(int document_id, const DocumentData& document_data);
+    void RemoveDocumentData(int document_id);
+    void RemoveWordFrequencies(int document_id); //из прямого индекса и из карт, собранных по снимку
+    
+    template <typename DocumentPredicate>
+    bool IsAccepted(const DocumentPredicate& predicate, int document_id) const {
+        if constexpr (std::is_same_v<DocumentPredicate, StatusPredicate>) {
+            return status_documents_[static_cast<size_t>(predicate.status)].Contains(document_id);
+        } else {
+            const auto& document_data = documents_.at(document_id);
+            return predicate(document_id, document_data.status, document_data.rating);
+        }
+    }
+    //то же, но возвращает данные принятого документа, не ища их второй раз; nullptr, если документ отвергнут
+    template <typename DocumentPredicate>
+    const DocumentData* FindAcceptedDocument(const DocumentPredicate& predicate, int document_id) const {
+        if constexpr (std::is_same_v<DocumentPredicate, StatusPredicate>) {
+            return IsAccepted(predicate, document_id) ? &documents_.at(document_id) : nullptr;
+        } else {
+            const auto& document_data = documents_.at(document_id);
+            return predicate(document_id, document_data.status, document_data.rating) ? &document_data : nullptr;
+        }
+    }
+    //Документы хотя бы с одним минус-словом запроса. Если budget велит остановиться, карта остаётся неполной,
+    //но тогда и подсчёт релевантности останавливается, не начав перебор, так что лишнего в выдачу не попадёт
+    template <typename Stats>
+    DocumentBitmap BuildExcludedDocuments(const Query& query, Stats& stats, const QueryBudget* budget) const;
+    
+    template <typename ExecutionPolicy>
+    static void SelectTopDocuments(ExecutionPolicy&& policy, std::vector<Document>& documents, size_t top_count);
     
     template <typename StringContainer>
-    static std::set<std::string> ParseStopWords(const StringContainer& strings);
-    std::vector<std::string> ParseDocument(const std::string& text) const;
+    static std::set<std::string, std::less<>> ParseStopWords(const StringContainer& strings);
+    std::pmr::vector<std::string_view> ParseDocument(std::string_view text, std::pmr::memory_resource* resource) const;
     
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const Query& query, DocumentPredicate predicate) const;
+    //Stats - QueryStats или NoQueryStats; во втором случае замеры не компилируются вовсе
+    template <typename ExecutionPolicy, typename Stats>
+    std::vector<Document> FindStatusTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus sought_status,
+                                                 size_t top_count, Stats& stats) const;
+    //after задаёт границу страницы: если он есть, ищутся только документы, идущие в выдаче после него.
+    //С budget перебор прекращается, когда тот велит остановиться, и выдаются лучшие из уже найденных документов
+    template <typename ExecutionPolicy, typename DocumentPredicate, typename Stats>
+    std::vector<Document> FindQueryTopDocuments(ExecutionPolicy&& policy, const Query& query, DocumentPredicate predicate, size_t top_count,
+                                                Stats& stats, const Document* after = nullptr, const QueryBudget* budget = nullptr) const;
+    static std::string MakeQueryCacheKey(const Query& query, DocumentStatus sought_status, size_t top_count);
+    
+    template <typename DocumentPredicate, typename Stats>
+    std::vector<Document> FindTopCandidates(const Query& query, DocumentPredicate predicate, size_t top_count, Stats& stats,
+                                            const Document* after, const QueryBudget* budget) const;
+    template <typename DocumentPredicate, typename Stats>
+    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy&, const Query& query, DocumentPredicate predicate,
+                                           Stats& stats, const QueryBudget* budget) const;
+    template <typename Stats>
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchQuery(std::string_view raw_query, int document_id, Stats& stats) const;
     
-    Query ParseQuery(const std::string& text) const;
-    QueryWord ParseQueryWord(std::string text) const;
+    //разобранный запрос живёт на арене потока, поэтому вызывающий держит открытой ScratchScope
+    template <typename Stats>
+    Query ParseQuery(std::string_view text, Stats& stats) const {
+        QueryPhaseTimer timer(stats, &QueryStats::parse_time);
+        return ParseQuery(text, ScratchScope::GetResource());
+    }
+    Query ParseQuery(std::string_view text, std::pmr::memory_resource* resource) const;
+    QueryWord ParseQueryWord(std::string_view text) const;
 };
 
 template <typename StringContainer>
-std::set<std::string> SearchServer::ParseStopWords(const StringContainer& strings) {
-    std::set<std::string> non_empty_strings;
-    for (const std::string& str : strings) {
+std::set<std::string, std::less<>> SearchServer::ParseStopWords(const StringContainer& strings) {
+    std::set<std::string, std::less<>> non_empty_strings;
+    for (const std::string_view str : strings) {
         if (!str.empty()) {
             if (!IsValidWord(str)) {
                 using namespace std::string_literals;
-                throw std::invalid_argument("invalid word "s + str + " was passed as stop word"s);
+                throw std::invalid_argument("invalid word "s + std::string(str) + " was passed as stop word"s);
             }
-            non_empty_strings.insert(str);
+            non_empty_strings.emplace(str);
         }
     }
     return non_empty_strings;
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(const std::string& raw_query, DocumentPredicate predicate) const {
-    std::vector<Document> matched_documents = FindAllDocuments(ParseQuery(raw_query), predicate);
-    
-    std::sort(matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-         if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
-             return lhs.rating > rhs.rating;
-         }
-         return lhs.relevance > rhs.relevance;
-    });
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate predicate, size_t top_count) const {
+    return FindTopDocuments(std::execution::seq, raw_query, predicate, top_count);
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate predicate,
+                                                     size_t top_count) const {
+    ScratchScope scope;
+    NoQueryStats stats;
+    return FindQueryTopDocuments(policy, ParseQuery(raw_query, stats), predicate, top_count, stats);
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus sought_status,
+                                                     size_t top_count) const {
+    NoQueryStats stats;
+    return FindStatusTopDocuments(policy, raw_query, sought_status, top_count, stats);
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate predicate,
+                                                     size_t top_count, QueryStats& stats) const {
+    ScratchScope scope;
+    stats = {};
+    std::vector<Document> documents = FindQueryTopDocuments(policy, ParseQuery(raw_query, stats), predicate, top_count, stats);
+    stats.result_count = documents.size();
+    query_metrics_->Record(stats);
+    return documents;
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus sought_status,
+                                                     size_t top_count, QueryStats& stats) const {
+    stats = {};
+    std::vector<Document> documents = FindStatusTopDocuments(policy, raw_query, sought_status, top_count, stats);
+    stats.result_count = documents.size();
+    query_metrics_->Record(stats);
+    return documents;
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+SearchResult SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate predicate, size_t top_count,
+                                            std::chrono::steady_clock::time_point deadline, const CancellationToken& token) const {
+    const QueryBudget budget(deadline, token);
+    if (budget.ShouldStop()) {
+        return {{}, true};
+    }
+    ScratchScope scope;
+    NoQueryStats stats;
+    std::vector<Document> documents = FindQueryTopDocuments(policy, ParseQuery(raw_query, stats), predicate, top_count, stats, nullptr, &budget);
+    return {std::move(documents), budget.IsStopped()};
+}
+
+template <typename ExecutionPolicy>
+SearchResult SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus sought_status, size_t top_count,
+                                            std::chrono::steady_clock::time_point deadline, const CancellationToken& token) const {
+    return FindTopDocuments(policy, raw_query, StatusPredicate{sought_status}, top_count, deadline, token);
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindNextPage(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate predicate, size_t page_size,
+                                                 PageCursor& cursor) const {
+    if (cursor.is_exhausted_) {
+        return {};
+    }
+    ScratchScope scope;
+    NoQueryStats stats;
+    std::vector<Document> documents = FindQueryTopDocuments(policy, ParseQuery(raw_query, stats), predicate, page_size, stats,
+                                                            cursor.has_last_document_ ? &cursor.last_document_ : nullptr);
+    if (!documents.empty()) {
+        cursor.has_last_document_ = true;
+        cursor.last_document_ = documents.back();
+    }
+    cursor.is_exhausted_ = documents.size() < page_size;
+    return documents;
+}
+
+template <typename ExecutionPolicy, typename Stats>
+std::vector<Document> SearchServer::FindStatusTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus sought_status,
+                                                           size_t top_count, Stats& stats) const {
+    ScratchScope scope;
+    const Query query = ParseQuery(raw_query, stats);
+    const StatusPredicate predicate{sought_status};
+    if (!query_cache_) {
+        return FindQueryTopDocuments(policy, query, predicate, top_count, stats);
+    }
     
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    //ключ строится по разобранному запросу, поэтому запросы, отличающиеся порядком или повтором слов, делят одну запись;
+    //при попадании в кэш в статистике остаются только разбор запроса и число результатов
+    const std::string key = MakeQueryCacheKey(query, sought_status, top_count);
+    const uint64_t epoch = epoch_;
+    if (auto documents = query_cache_->Find(key, epoch)) {
+        return *documents;
+    }
+    std::vector<Document> documents = FindQueryTopDocuments(policy, query, predicate, top_count, stats);
+    query_cache_->Insert(key, epoch, documents);
+    return documents;
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate, typename Stats>
+std::vector<Document> SearchServer::FindQueryTopDocuments(ExecutionPolicy&& policy, const Query& query, DocumentPredicate predicate,
+                                                          size_t top_count, Stats& stats, const Document* after, const QueryBudget* budget) const {
+    //вспомогательные структуры поиска берут память у арены потока
+    ScratchScope scope;
+    std::vector<Document> matched_documents;
+    {
+        QueryPhaseTimer timer(stats, &QueryStats::scoring_time);
+        if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>) {
+            matched_documents = FindTopCandidates(query, predicate, top_count, stats, after, budget);
+        } else {
+            matched_documents = FindAllDocuments(std::execution::par, query, predicate, stats, budget);
+            if (after) {
+                matched_documents.erase(std::remove_if(matched_documents.begin(), matched_documents.end(), [after](const Document& document) {
+                    return !IsMoreRelevant(*after, document);
+                }), matched_documents.end());
+            }
+        }
+    }
+    if constexpr (Stats::enabled) {
+        //отсев минус-словами замерялся внутри подсчёта релевантности
+        stats.scoring_time -= stats.minus_filter_time;
     }
+    
+    QueryPhaseTimer timer(stats, &QueryStats::sort_time);
+    SelectTopDocuments(policy, matched_documents, top_count);
     return matched_documents;
 }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentPredicate predicate) const {
-    std::map<int, double> document_to_relevance;
-    for (const std::string& word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+template <typename ExecutionPolicy>
+void SearchServer::SelectTopDocuments(ExecutionPolicy&& policy, std::vector<Document>& documents, size_t top_count) {
+    //упорядочиваем только первые top_count документов вместо сортировки всех найденных
+    const size_t count = std::min(top_count, documents.size());
+    std::partial_sort(policy, documents.begin(), documents.begin() + count, documents.end(), IsMoreRelevant);
+    documents.resize(count);
+}
+
+template <typename Function>
+void SearchServer::ForEachPrefixExpansion(std::string_view prefix_word, std::string_view last_word, Function function) const {
+    //пустые списки остались от удалённых документов и в предел раскрытия не засчитываются
+    size_t expansion_count = 0;
+    GetTermDictionary().ForEachWithPrefix(prefix_word.substr(0, prefix_word.size() - 1), [&](std::string_view word, size_t term_id) {
+        if (!last_word.empty() && word > last_word) {
+            return false;
+        }
+        if (postings_[term_id].size() != 0) {
+            function(word, postings_[term_id]);
+            ++expansion_count;
+        }
+        return expansion_count < MAX_PREFIX_EXPANSION_COUNT;
+    });
+}
+
+template <typename Function>
+void SearchServer::ForEachQueryPostingList(std::string_view word, std::string_view prefix_last_word, Function function) const {
+    if (!IsPrefixWord(word)) {
+        if (const PostingList* posting_list = FindPostingList(GetExactWord(word))) {
+            function(*posting_list);
+        }
+        return;
+    }
+    ForEachPrefixExpansion(word, prefix_last_word, [&](std::string_view, const PostingList& posting_list) {
+        function(posting_list);
+    });
+}
+
+template <typename Function>
+void SearchServer::ForEachDocumentWord(int document_id, Function function) const {
+    if (const auto it = document_to_word_freqs_.find(document_id); it != document_to_word_freqs_.end()) {
+        for (const auto& [word, _] : it->second) {
+            function(word);
+        }
+        return;
+    }
+    const auto [begin, end] = FindMappedDocumentWords(document_id);
+    for (const uint32_t* term_id = begin; term_id != end; ++term_id) {
+        function(mapped_forward_index_.terms[*term_id]);
+    }
+}
+
+//MaxScore: документы перебираются по возрастанию id сразу по всем спискам постингов.
+//Когда набрано top_count кандидатов, слова, чьи верхние оценки в сумме не дотягивают до худшего кандидата,
+//перестают порождать новых кандидатов и только досчитывают релевантность остальных
+template <typename DocumentPredicate, typename Stats>
+std::vector<Document> SearchServer::FindTopCandidates(const Query& query, DocumentPredicate predicate, size_t top_count, Stats& stats,
+                                                      const Document* after, const QueryBudget* budget) const {
+    struct TermCursor {
+        PostingList::Cursor postings;
+        double inverse_document_freq;
+        double upper_bound;
+    };
+    
+    //курсоры идут в порядке плюс-слов, чтобы релевантность суммировалась так же, как в FindAllDocuments
+    std::pmr::memory_resource* scratch = ScratchScope::GetResource();
+    std::pmr::vector<TermCursor> cursors(scratch);
+    std::pmr::vector<PostingList> prefix_postings(query.plus_words.size(), scratch); //сразу нужного размера: курсоры ссылаются на элементы
+    for (size_t i = 0; i < query.plus_words.size(); ++i) {
+        const std::string_view word = query.plus_words[i];
+        if (const PostingList* posting_list = FindQueryPostingList(word, query.FindPrefixLastWord(word), prefix_postings[i], budget)) {
+            const double inverse_document_freq = ComputeWordInverseDocumentFreq(query, i, *posting_list);
+            cursors.push_back({PostingList::Cursor(*posting_list), inverse_document_freq, posting_list->max_term_freq * inverse_document_freq});
+        }
+    }
+    //кандидаты идут по возрастанию id, поэтому минус-слова проверяются курсорами, которые только продвигаются вперёд;
+    //у минус-префикса объединять списки незачем, достаточно курсора на каждое раскрытое слово
+    std::pmr::vector<PostingList::Cursor> minus_cursors(scratch);
+    for (const std::string_view word : query.minus_words) {
+        ForEachQueryPostingList(word, query.FindPrefixLastWord(word), [&](const PostingList& posting_list) {
+            minus_cursors.emplace_back(posting_list);
+        });
+    }
+    if (cursors.empty() || top_count == 0) {
+        return {};
+    }
+    
+    //by_bound - индексы курсоров по возрастанию верхней оценки; bound_sums[i] - сумма оценок первых i + 1 из них
+    std::pmr::vector<size_t> by_bound(cursors.size(), scratch);
+    for (size_t i = 0; i < by_bound.size(); ++i) {
+        by_bound[i] = i;
+    }
+    std::sort(by_bound.begin(), by_bound.end(), [&](size_t lhs, size_t rhs) {
+        return cursors[lhs].upper_bound < cursors[rhs].upper_bound;
+    });
+    std::pmr::vector<double> bound_sums(by_bound.size(), scratch);
+    double bound_sum = 0.0;
+    for (size_t i = 0; i < by_bound.size(); ++i) {
+        bound_sum += cursors[by_bound[i]].upper_bound;
+        bound_sums[i] = bound_sum;
+    }
+    
+    //в куче на вершине худший из лучших; документ хуже порога заведомо не войдёт в выдачу,
+    //запас в 2 * EPSILON учитывает сравнение по рейтингу при почти равной релевантности
+    std::vector<Document> top_documents;
+    auto threshold = [&]() {
+        return top_documents.size() < top_count ? -std::numeric_limits<double>::infinity()
+                                                : top_documents.front().relevance - 2 * EPSILON;
+    };
+    size_t first_essential = 0;
+    
+    std::pmr::vector<double> contributions(cursors.size(), scratch);
+    //срок проверяется раз в POSTING_BLOCK_SIZE документов; прерванный перебор отдаёт лучших из уже просмотренных
+    for (size_t step = 0; ; ++step) {
+        if (budget && step % POSTING_BLOCK_SIZE == 0 && budget->ShouldStop()) {
+            break;
+        }
+        //конец списков отмечается отдельно: документ с id INT_MAX тоже настоящий
+        std::optional<int> next_id;
+        for (size_t i = first_essential; i < by_bound.size(); ++i) {
+            const TermCursor& cursor = cursors[by_bound[i]];
+            if (!cursor.postings.IsExhausted() && (!next_id || cursor.postings.CurrentId() < *next_id)) {
+                next_id = cursor.postings.CurrentId();
+            }
+        }
+        if (!next_id) {
+            break;
+        }
+        const int document_id = *next_id;
+        
+        std::fill(contributions.begin(), contributions.end(), 0.0);
+        double estimate = 0.0;
+        for (size_t i = first_essential; i < by_bound.size(); ++i) {
+            TermCursor& cursor = cursors[by_bound[i]];
+            if (!cursor.postings.IsExhausted() && cursor.postings.CurrentId() == document_id) {
+                contributions[by_bound[i]] = cursor.postings.CurrentTermFreq() * cursor.inverse_document_freq;
+                estimate += contributions[by_bound[i]];
+                cursor.postings.Next();
+                if constexpr (Stats::enabled) {
+                    ++stats.postings_scanned;
+                }
+            }
+        }
+        
+        bool is_pruned = false;
+        for (size_t i = first_essential; i-- > 0; ) {
+            if (estimate + bound_sums[i] < threshold()) {
+                is_pruned = true;
+                break;
+            }
+            TermCursor& cursor = cursors[by_bound[i]];
+            cursor.postings.SeekTo(document_id);
+            if constexpr (Stats::enabled) {
+                ++stats.postings_scanned;
+            }
+            if (!cursor.postings.IsExhausted() && cursor.postings.CurrentId() == document_id) {
+                contributions[by_bound[i]] = cursor.postings.CurrentTermFreq() * cursor.inverse_document_freq;
+                estimate += contributions[by_bound[i]];
+            }
+        }
+        if (is_pruned || estimate < threshold()) {
+            continue;
+        }
+        //документ заметно релевантнее границы страницы уже был выдан; при почти равной релевантности всё решит рейтинг
+        if (after && estimate > after->relevance + 2 * EPSILON) {
             continue;
         }
         
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto& [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-            const auto& document_data = documents_.at(document_id);
-            if (predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+        bool is_excluded;
+        {
+            QueryPhaseTimer timer(stats, &QueryStats::minus_filter_time);
+            is_excluded = std::any_of(minus_cursors.begin(), minus_cursors.end(), [&](PostingList::Cursor& cursor) {
+                if constexpr (Stats::enabled) {
+                    ++stats.postings_scanned;
+                }
+                cursor.SeekTo(document_id);
+                return !cursor.IsExhausted() && cursor.CurrentId() == document_id;
+            });
+        }
+        if (is_excluded) {
+            continue;
+        }
+        const DocumentData* document_data = FindAcceptedDocument(predicate, document_id);
+        if (!document_data) {
+            if constexpr (Stats::enabled) {
+                ++stats.predicate_rejections;
             }
+            continue;
         }
-    }
-    
-    for (const std::string& word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+        
+        double relevance = 0.0;
+        for (const double contribution : contributions) {
+            relevance += contribution;
+        }
+        
+        const Document document(document_id, relevance, document_data->rating);
+        if (after && !IsMoreRelevant(*after, document)) {
             continue;
         }
-        for (const auto& [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
+        if (top_documents.size() < top_count) {
+            top_documents.push_back(document);
+            std::push_heap(top_documents.begin(), top_documents.end(), IsMoreRelevant);
+        } else if (IsMoreRelevant(document, top_documents.front())) {
+            std::pop_heap(top_documents.begin(), top_documents.end(), IsMoreRelevant);
+            top_documents.back() = document;
+            std::push_heap(top_documents.begin(), top_documents.end(), IsMoreRelevant);
+        }
+        
+        while (first_essential < by_bound.size() && bound_sums[first_essential] < threshold()) {
+            ++first_essential;
+        }
+    }
+    return top_documents;
+}
+
+//битовая карта собирается до подсчёта релевантности, чтобы документы с минус-словами отсеивались сразу,
+//а не набирали релевантность и удалялись из словаря потом по одному
+template <typename Stats>
+DocumentBitmap SearchServer::BuildExcludedDocuments(const Query& query, Stats& stats, const QueryBudget* budget) const {
+    QueryPhaseTimer timer(stats, &QueryStats::minus_filter_time);
+    DocumentBitmap excluded_documents;
+    for (const std::string_view word : query.minus_words) {
+        ForEachQueryPostingList(word, query.FindPrefixLastWord(word), [&](const PostingList& posting_list) {
+            posting_list.ForEachUntil([&](int document_id, double) {
+                excluded_documents.Add(document_id);
+            }, [budget]() {
+                return budget && budget->ShouldStop();
+            });
+            if constexpr (Stats::enabled) {
+                stats.postings_scanned += posting_list.size();
+            }
+        });
+    }
+    return excluded_documents;
+}
+
+template <typename DocumentPredicate, typename Stats>
+std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy&, const Query& query, DocumentPredicate predicate,
+                                                     Stats& stats, const QueryBudget* budget) const {
+    //Плюс-слова обрабатываются параллельно, и каждое раскладывает свои вклады в релевантность по корзинам словаря.
+    //Затем каждая корзина складывает вклады своих документов в порядке плюс-слов, как и последовательный поиск,
+    //так что суммы совпадают с ним до бита. Статистику каждое слово копит у себя и добавляет в общую один раз
+    const DocumentBitmap excluded_documents = BuildExcludedDocuments(query, stats, budget);
+    ConcurrentMap<int, double> document_to_relevance(RELEVANCE_MAP_BUCKET_COUNT);
+    std::vector<std::vector<std::vector<std::pair<int, double>>>> word_contributions(query.plus_words.size()); //[слово][корзина]
+    std::atomic<uint64_t> postings_scanned{0};
+    std::mutex rejected_documents_mutex;
+    DocumentBitmap rejected_documents;
+    //обход идёт по номерам слов: string_view тривиально копируется, и параллельный алгоритм вправе передать лямбде копию,
+    //так что номер по адресу элемента не вычислить
+    std::vector<size_t> word_indexes(query.plus_words.size());
+    std::iota(word_indexes.begin(), word_indexes.end(), 0);
+    std::for_each(std::execution::par, word_indexes.begin(), word_indexes.end(), [&](size_t word_index) {
+        PostingList prefix_postings;
+        const std::string_view word = query.plus_words[word_index];
+        const PostingList* posting_list = FindQueryPostingList(word, query.FindPrefixLastWord(word), prefix_postings, budget);
+        if (!posting_list) {
+            return;
+        }
+        
+        const double inverse_document_freq = ComputeWordInverseDocumentFreq(query, word_index, *posting_list);
+        auto& contributions = word_contributions[word_index];
+        contributions.resize(RELEVANCE_MAP_BUCKET_COUNT);
+        std::vector<int> word_rejections;
+        posting_list->ForEachUntil([&](int document_id, double term_freq) {
+            if (excluded_documents.Contains(document_id)) {
+                return;
+            }
+            if (IsAccepted(predicate, document_id)) {
+                contributions[static_cast<uint64_t>(document_id) % RELEVANCE_MAP_BUCKET_COUNT].emplace_back(document_id, term_freq * inverse_document_freq);
+            } else if constexpr (Stats::enabled) {
+                word_rejections.push_back(document_id);
+            }
+        }, [budget]() {
+            return budget && budget->ShouldStop();
+        });
+        if constexpr (Stats::enabled) {
+            postings_scanned += posting_list->size();
+            std::lock_guard guard(rejected_documents_mutex);
+            for (const int document_id : word_rejections) {
+                rejected_documents.Add(document_id);
+            }
         }
+    });
+    //корзину заполняет один поток, так что её мьютекс не оспаривается
+    std::vector<size_t> bucket_indexes(RELEVANCE_MAP_BUCKET_COUNT);
+    std::iota(bucket_indexes.begin(), bucket_indexes.end(), 0);
+    std::for_each(std::execution::par, bucket_indexes.begin(), bucket_indexes.end(), [&](size_t bucket_index) {
+        for (const auto& contributions : word_contributions) {
+            if (contributions.empty()) {
+                continue;
+            }
+            for (const auto& [document_id, contribution] : contributions[bucket_index]) {
+                document_to_relevance[document_id].ref_to_value += contribution;
+            }
+        }
+    });
+    
+    if constexpr (Stats::enabled) {
+        stats.postings_scanned += postings_scanned;
+        stats.predicate_rejections += rejected_documents.size();
     }
     
     std::vector<Document> matched_documents;
-    for (const auto& [document_id, relevance] : document_to_relevance) {
+    for (const auto& [document_id, relevance] : document_to_relevance.BuildOrdinaryMap()) {
         matched_documents.emplace_back(document_id, relevance, documents_.at(document_id).rating);
     }
     return matched_documents;
@@ -0,0 +1,476 @@
+#include "search_shard.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std::string_literals;
+
+void LocalSearchShard::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    server_.AddDocument(document_id, document, status, ratings);
+}
+
+size_t LocalSearchShard::GetDocumentCount() const {
+    return server_.GetDocumentCount();
+}
+
+std::vector<std::vector<std::string>> LocalSearchShard::GetPrefixExpansions(const SearchServer::Query& query) const {
+    return server_.GetPrefixExpansions(query);
+}
+
+std::vector<size_t> LocalSearchShard::GetDocumentFrequencies(const SearchServer::Query& query) const {
+    std::vector<size_t> document_freqs;
+    document_freqs.reserve(query.plus_words.size());
+    for (const std::string_view word : query.plus_words) {
+        document_freqs.push_back(server_.GetDocumentFrequency(word, query.FindPrefixLastWord(word)));
+    }
+    return document_freqs;
+}
+
+std::vector<Document> LocalSearchShard::FindTopDocuments(const SearchServer::Query& query, DocumentStatus sought_status, size_t top_count) const {
+    return server_.FindQueryTopDocuments(std::execution::seq, query, SearchServer::StatusPredicate{sought_status}, top_count);
+}
+
+namespace {
+
+//Сообщение - длина (uint64) и следом тело. Тело запроса начинается с ShardRequest, тело ответа - с ShardReply;
+//числа передаются в родном порядке байт, сокет локальный
+enum class ShardRequest : uint8_t {
+    ADD_DOCUMENT,
+    GET_DOCUMENT_COUNT,
+    GET_DOCUMENT_FREQUENCIES,
+    FIND_TOP_DOCUMENTS,
+    GET_PREFIX_EXPANSIONS,
+};
+
+enum class ShardReply : uint8_t {
+    OK,
+    INVALID_ARGUMENT,
+    OUT_OF_RANGE,
+    ERROR,
+};
+
+class MessageWriter {
+public:
+    template <typename T>
+    void Write(T value) {
+        data_.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+    void WriteString(std::string_view str) {
+        Write<uint64_t>(str.size());
+        data_ += str;
+    }
+    template <typename Strings>
+    void WriteStrings(const Strings& strings) {
+        Write<uint64_t>(strings.size());
+        for (const std::string_view str : strings) {
+            WriteString(str);
+        }
+    }
+    
+    const std::string& GetData() const { return data_; }
+
+private:
+    std::string data_;
+};
+
+//строки, прочитанные из сообщения, ссылаются на его буфер
+class MessageReader {
+public:
+    explicit MessageReader(std::string_view data) : data_(data) {}
+    
+    template <typename T>
+    T Read() {
+        T value;
+        std::memcpy(&value, Take(sizeof(value)), sizeof(value));
+        return value;
+    }
+    std::string_view ReadString() {
+        const size_t size = Read<uint64_t>();
+        return {Take(size), size};
+    }
+    template <typename Strings>
+    void ReadStrings(Strings& strings) {
+        //у каждой строки есть хотя бы длина
+        const size_t count = ReadCount(sizeof(uint64_t));
+        for (size_t i = 0; i < count; ++i) {
+            strings.emplace_back(ReadString());
+        }
+    }
+    //Число элементов, каждый из которых занимает в сообщении не меньше element_size байт. Число больше, чем уместится
+    //в остаток сообщения, отвергается до того, как под элементы выделится память
+    size_t ReadCount(size_t element_size) {
+        const size_t count = Read<uint64_t>();
+        if (count > (data_.size() - pos_) / element_size) {
+            throw std::runtime_error("truncated shard message"s);
+        }
+        return count;
+    }
+
+private:
+    const char* Take(size_t size) {
+        if (size > data_.size() - pos_) {
+            throw std::runtime_error("truncated shard message"s);
+        }
+        const char* result = data_.data() + pos_;
+        pos_ += size;
+        return result;
+    }
+    
+    std::string_view data_;
+    size_t pos_ = 0;
+};
+
+void SendAll(int socket, const char* data, size_t size) {
+    while (size != 0) {
+        const ssize_t sent = send(socket, data, size, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("shard connection write failed: "s + std::strerror(errno));
+        }
+        data += sent;
+        size -= sent;
+    }
+}
+
+//false, если соединение закрыто до первого байта
+bool ReceiveAll(int socket, char* data, size_t size) {
+    bool is_started = false;
+    while (size != 0) {
+        const ssize_t received = recv(socket, data, size, 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received < 0) {
+            throw std::runtime_error("shard connection read failed: "s + std::strerror(errno));
+        }
+        if (received == 0) {
+            if (!is_started) {
+                return false;
+            }
+            throw std::runtime_error("shard connection closed mid-message"s);
+        }
+        is_started = true;
+        data += received;
+        size -= received;
+    }
+    return true;
+}
+
+void SendMessage(int socket, const std::string& message) {
+    if (message.size() > MAX_SHARD_MESSAGE_SIZE) {
+        throw std::invalid_argument("shard message of "s + std::to_string(message.size()) + " bytes is too large"s);
+    }
+    const uint64_t size = message.size();
+    SendAll(socket, reinterpret_cast<const char*>(&size), sizeof(size));
+    SendAll(socket, message.data(), message.size());
+}
+
+bool ReceiveMessage(int socket, std::string& message) {
+    uint64_t size;
+    if (!ReceiveAll(socket, reinterpret_cast<char*>(&size), sizeof(size))) {
+        return false;
+    }
+    if (size > MAX_SHARD_MESSAGE_SIZE) {
+        throw std::runtime_error("shard message of "s + std::to_string(size) + " bytes is too large"s);
+    }
+    message.resize(size);
+    if (size != 0 && !ReceiveAll(socket, message.data(), size)) {
+        throw std::runtime_error("shard connection closed mid-message"s);
+    }
+    return true;
+}
+
+sockaddr_un MakeSocketAddress(const std::string& socket_path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        throw std::invalid_argument("shard socket path "s + socket_path + " is too long"s);
+    }
+    std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+    return address;
+}
+
+void WriteQuery(MessageWriter& writer, const SearchServer::Query& query) {
+    writer.WriteStrings(query.plus_words);
+    writer.WriteStrings(query.minus_words);
+    writer.Write<uint64_t>(query.plus_word_idfs.size());
+    for (const double inverse_document_freq : query.plus_word_idfs) {
+        writer.Write(inverse_document_freq);
+    }
+    writer.WriteStrings(query.prefix_words);
+    writer.WriteStrings(query.prefix_last_words);
+}
+
+DocumentStatus ReadStatus(MessageReader& reader) {
+    const auto status = reader.Read<DocumentStatus>();
+    if (static_cast<uint32_t>(status) > static_cast<uint32_t>(DocumentStatus::REMOVED)) {
+        throw std::invalid_argument("unknown document status in shard request"s);
+    }
+    return status;
+}
+
+SearchServer::Query ReadQuery(MessageReader& reader) {
+    SearchServer::Query query;
+    reader.ReadStrings(query.plus_words);
+    reader.ReadStrings(query.minus_words);
+    const size_t idf_count = reader.ReadCount(sizeof(double));
+    //idf либо не переданы, либо есть у каждого плюс-слова: поиск берёт их по номеру слова
+    if (idf_count != 0 && idf_count != query.plus_words.size()) {
+        throw std::invalid_argument("shard query has "s + std::to_string(idf_count) + " idfs for "s
+                                    + std::to_string(query.plus_words.size()) + " plus words"s);
+    }
+    for (size_t i = 0; i < idf_count; ++i) {
+        query.plus_word_idfs.push_back(reader.Read<double>());
+    }
+    reader.ReadStrings(query.prefix_words);
+    reader.ReadStrings(query.prefix_last_words);
+    //границы ищутся двоичным поиском по префиксам
+    if (query.prefix_last_words.size() != query.prefix_words.size()
+        || std::adjacent_find(query.prefix_words.begin(), query.prefix_words.end(), std::greater_equal<>()) != query.prefix_words.end()) {
+        throw std::invalid_argument("shard query has malformed prefix bounds"s);
+    }
+    return query;
+}
+
+//выполняет запрос и пишет в writer тело ответа без кода
+void HandleRequest(SearchServer& server, MessageReader& request, MessageWriter& writer) {
+    switch (request.Read<ShardRequest>()) {
+        case ShardRequest::ADD_DOCUMENT: {
+            const int document_id = request.Read<int32_t>();
+            const DocumentStatus status = ReadStatus(request);
+            std::vector<int> ratings(request.ReadCount(sizeof(int32_t)));
+            for (int& rating : ratings) {
+                rating = request.Read<int32_t>();
+            }
+            server.AddDocument(document_id, request.ReadString(), status, ratings);
+            break;
+        }
+        case ShardRequest::GET_DOCUMENT_COUNT:
+            writer.Write<uint64_t>(server.GetDocumentCount());
+            break;
+        case ShardRequest::GET_DOCUMENT_FREQUENCIES: {
+            const SearchServer::Query query = ReadQuery(request);
+            for (const std::string_view word : query.plus_words) {
+                writer.Write<uint64_t>(server.GetDocumentFrequency(word, query.FindPrefixLastWord(word)));
+            }
+            break;
+        }
+        case ShardRequest::GET_PREFIX_EXPANSIONS: {
+            const std::vector<std::vector<std::string>> expansions = server.GetPrefixExpansions(ReadQuery(request));
+            writer.Write<uint64_t>(expansions.size());
+            for (const std::vector<std::string>& words : expansions) {
+                writer.WriteStrings(words);
+            }
+            break;
+        }
+        case ShardRequest::FIND_TOP_DOCUMENTS: {
+            const DocumentStatus status = ReadStatus(request);
+            const size_t top_count = request.Read<uint64_t>();
+            const SearchServer::Query query = ReadQuery(request);
+            const std::vector<Document> documents = server.FindQueryTopDocuments(std::execution::seq, query,
+                                                                                 SearchServer::StatusPredicate{status}, top_count);
+            writer.Write<uint64_t>(documents.size());
+            for (const Document& document : documents) {
+                writer.Write<int32_t>(document.id);
+                writer.Write(document.relevance);
+                writer.Write<int32_t>(document.rating);
+            }
+            break;
+        }
+        default:
+            throw std::runtime_error("unknown shard request"s);
+    }
+}
+
+} // namespace
+
+SocketSearchShard::SocketSearchShard(const std::string& socket_path) {
+    const sockaddr_un address = MakeSocketAddress(socket_path);
+    for (size_t attempt = 0; ; ++attempt) {
+        socket_ = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (socket_ < 0) {
+            throw std::runtime_error("cannot create shard socket: "s + std::strerror(errno));
+        }
+        if (connect(socket_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0) {
+            return;
+        }
+        const int error = errno;
+        close(socket_);
+        if (attempt + 1 == SHARD_CONNECT_ATTEMPTS || (error != ENOENT && error != ECONNREFUSED)) {
+            throw std::runtime_error("cannot connect to shard "s + socket_path + ": "s + std::strerror(error));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(SHARD_CONNECT_RETRY_MS));
+    }
+}
+
+SocketSearchShard::~SocketSearchShard() {
+    close(socket_);
+}
+
+void SocketSearchShard::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    MessageWriter writer;
+    writer.Write(ShardRequest::ADD_DOCUMENT);
+    writer.Write<int32_t>(document_id);
+    writer.Write(status);
+    writer.Write<uint64_t>(ratings.size());
+    for (const int rating : ratings) {
+        writer.Write<int32_t>(rating);
+    }
+    writer.WriteString(document);
+    Call(writer.GetData());
+}
+
+size_t SocketSearchShard::GetDocumentCount() const {
+    MessageWriter writer;
+    writer.Write(ShardRequest::GET_DOCUMENT_COUNT);
+    const std::string reply = Call(writer.GetData());
+    return MessageReader(reply).Read<uint64_t>();
+}
+
+std::vector<std::vector<std::string>> SocketSearchShard::GetPrefixExpansions(const SearchServer::Query& query) const {
+    MessageWriter writer;
+    writer.Write(ShardRequest::GET_PREFIX_EXPANSIONS);
+    WriteQuery(writer, query);
+    const std::string reply = Call(writer.GetData());
+    
+    MessageReader reader(reply);
+    std::vector<std::vector<std::string>> expansions(reader.ReadCount(sizeof(uint64_t)));
+    if (expansions.size() != SearchServer::GetPrefixWords(query).size()) {
+        throw std::runtime_error("shard expanded "s + std::to_string(expansions.size()) + " prefixes instead of "s
+                                 + std::to_string(SearchServer::GetPrefixWords(query).size()));
+    }
+    for (std::vector<std::string>& words : expansions) {
+        reader.ReadStrings(words);
+    }
+    return expansions;
+}
+
+std::vector<size_t> SocketSearchShard::GetDocumentFrequencies(const SearchServer::Query& query) const {
+    MessageWriter writer;
+    writer.Write(ShardRequest::GET_DOCUMENT_FREQUENCIES);
+    WriteQuery(writer, query);
+    const std::string reply = Call(writer.GetData());
+    
+    MessageReader reader(reply);
+    std::vector<size_t> document_freqs(query.plus_words.size());
+    for (size_t& document_freq : document_freqs) {
+        document_freq = reader.Read<uint64_t>();
+    }
+    return document_freqs;
+}
+
+std::vector<Document> SocketSearchShard::FindTopDocuments(const SearchServer::Query& query, DocumentStatus sought_status, size_t top_count) const {
+    MessageWriter writer;
+    writer.Write(ShardRequest::FIND_TOP_DOCUMENTS);
+    writer.Write(sought_status);
+    writer.Write<uint64_t>(top_count);
+    WriteQuery(writer, query);
+    const std::string reply = Call(writer.GetData());
+    
+    MessageReader reader(reply);
+    std::vector<Document> documents(reader.ReadCount(sizeof(int32_t) + sizeof(double) + sizeof(int32_t)));
+    for (Document& document : documents) {
+        document.id = reader.Read<int32_t>();
+        document.relevance = reader.Read<double>();
+        document.rating = reader.Read<int32_t>();
+    }
+    return documents;
+}
+
+std::string SocketSearchShard::Call(const std::string& request) const {
+    std::string reply;
+    {
+        std::lock_guard guard(mutex_);
+        SendMessage(socket_, request);
+        if (!ReceiveMessage(socket_, reply)) {
+            throw std::runtime_error("shard closed the connection"s);
+        }
+    }
+    if (reply.empty()) {
+        throw std::runtime_error("empty shard reply"s);
+    }
+    const ShardReply code = static_cast<ShardReply>(reply[0]);
+    if (code == ShardReply::OK) {
+        return reply.substr(1);
+    }
+    const std::string message = reply.substr(1);
+    if (code == ShardReply::INVALID_ARGUMENT) {
+        throw std::invalid_argument(message);
+    }
+    if (code == ShardReply::OUT_OF_RANGE) {
+        throw std::out_of_range(message);
+    }
+    throw std::runtime_error(message);
+}
+
+void ServeSearchShard(SearchServer& server, const std::string& socket_path) {
+    const sockaddr_un address = MakeSocketAddress(socket_path);
+    const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        throw std::runtime_error("cannot create shard socket: "s + std::strerror(errno));
+    }
+    unlink(socket_path.c_str());
+    if (bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 1) != 0) {
+        const int error = errno;
+        close(listener);
+        throw std::runtime_error("cannot listen on shard socket "s + socket_path + ": "s + std::strerror(error));
+    }
+    int connection;
+    do {
+        connection = accept(listener, nullptr, nullptr);
+    } while (connection < 0 && errno == EINTR);
+    const int error = errno;
+    close(listener);
+    unlink(socket_path.c_str());
+    if (connection < 0) {
+        throw std::runtime_error("cannot accept shard connection: "s + std::strerror(error));
+    }
+    
+    std::string request;
+    try {
+        while (ReceiveMessage(connection, request)) {
+            MessageReader reader(request);
+            MessageWriter writer;
+            writer.Write(ShardReply::OK);
+            //ошибка запроса отправляется клиенту, а соединение продолжает работать: сообщения разделены длиной,
+            //так что даже недочитанный запрос не сбивает следующие
+            auto send_error = [connection](ShardReply code, const char* message) {
+                MessageWriter error_writer;
+                error_writer.Write(code);
+                SendMessage(connection, error_writer.GetData() + message);
+            };
+            try {
+                HandleRequest(server, reader, writer);
+                if (writer.GetData().size() > MAX_SHARD_MESSAGE_SIZE) {
+                    throw std::length_error("shard reply of "s + std::to_string(writer.GetData().size())
+                                            + " bytes is too large"s);
+                }
+            } catch (const std::invalid_argument& e) {
+                send_error(ShardReply::INVALID_ARGUMENT, e.what());
+                continue;
+            } catch (const std::out_of_range& e) {
+                send_error(ShardReply::OUT_OF_RANGE, e.what());
+                continue;
+            } catch (const std::exception& e) {
+                send_error(ShardReply::ERROR, e.what());
+                continue;
+            }
+            SendMessage(connection, writer.GetData());
+        }
+    } catch (...) {
+        close(connection);
+        throw;
+    }
+    close(connection);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "document.h"
+#include "search_server.h"
+
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+const size_t SHARD_CONNECT_ATTEMPTS = 100;
+const int SHARD_CONNECT_RETRY_MS = 10;
+const size_t MAX_SHARD_MESSAGE_SIZE = size_t{1} << 30; //заявленная длина больше - сбой протокола, а не повод выделять память
+
+//Часть распределённого индекса. Поиск идёт в две фазы: сначала со всех шардов собирается статистика слов запроса,
+//затем каждому шарду отдаётся запрос с idf, посчитанными по всем шардам, и он возвращает свои лучшие документы.
+//Если в запросе есть префиксы, перед ними с шардов собираются первые слова префиксов, чтобы поставить им общие границы
+class SearchShard {
+public:
+    virtual ~SearchShard() = default;
+    
+    virtual void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) = 0;
+    virtual size_t GetDocumentCount() const = 0;
+    //SearchServer::GetPrefixExpansions шарда
+    virtual std::vector<std::vector<std::string>> GetPrefixExpansions(const SearchServer::Query& query) const = 0;
+    //число документов шарда с каждым плюс-словом запроса
+    virtual std::vector<size_t> GetDocumentFrequencies(const SearchServer::Query& query) const = 0;
+    virtual std::vector<Document> FindTopDocuments(const SearchServer::Query& query, DocumentStatus sought_status, size_t top_count) const = 0;
+};
+
+//шард в том же процессе
+class LocalSearchShard : public SearchShard {
+public:
+    template <typename StopWords>
+    explicit LocalSearchShard(const StopWords& stop_words) : server_(stop_words) {}
+    
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) override;
+    size_t GetDocumentCount() const override;
+    std::vector<std::vector<std::string>> GetPrefixExpansions(const SearchServer::Query& query) const override;
+    std::vector<size_t> GetDocumentFrequencies(const SearchServer::Query& query) const override;
+    std::vector<Document> FindTopDocuments(const SearchServer::Query& query, DocumentStatus sought_status, size_t top_count) const override;
+
+private:
+    SearchServer server_;
+};
+
+//Шард в другом процессе, обслуживаемый ServeSearchShard, через локальный сокет. Запросы к одному шарду идут
+//по одному соединению по очереди. Ошибки шарда пробрасываются как invalid_argument и out_of_range,
+//сбои соединения - как runtime_error. Запрос длиннее MAX_SHARD_MESSAGE_SIZE отвергается до отправки как invalid_argument
+class SocketSearchShard : public SearchShard {
+public:
+    //сервер шарда может ещё не успеть создать сокет, поэтому подключение повторяется SHARD_CONNECT_ATTEMPTS раз
+    explicit SocketSearchShard(const std::string& socket_path);
+    ~SocketSearchShard() override;
+    
+    SocketSearchShard(const SocketSearchShard&) = delete;
+    SocketSearchShard& operator=(const SocketSearchShard&) = delete;
+    
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) override;
+    size_t GetDocumentCount() const override;
+    std::vector<std::vector<std::string>> GetPrefixExpansions(const SearchServer::Query& query) const override;
+    std::vector<size_t> GetDocumentFrequencies(const SearchServer::Query& query) const override;
+    std::vector<Document> FindTopDocuments(const SearchServer::Query& query, DocumentStatus sought_status, size_t top_count) const override;
+
+private:
+    std::string Call(const std::string& request) const;
+    
+    int socket_ = -1;
+    mutable std::mutex mutex_;
+};
+
+//Создаёт сокет socket_path, принимает одно подключение и выполняет запросы SocketSearchShard к server,
+//пока клиент не отключится. Стоп-слова server должны совпадать со стоп-словами составного индекса.
+//На неверный запрос клиент получает ошибку, а на сообщение длиннее MAX_SHARD_MESSAGE_SIZE соединение закрывается
+//исключением: дочитать такое сообщение, чтобы перейти к следующему, нельзя
+void ServeSearchShard(SearchServer& server, const std::string& socket_path);
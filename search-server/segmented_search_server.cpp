@@ -0,0 +1,76 @@
+#include "segmented_search_server.h"
+
+#include <stdexcept>
+
+using namespace std::string_literals;
+
+void SegmentedSearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    std::lock_guard guard(writer_mutex_);
+    if (document_id < 0 || document_ids_.count(document_id) != 0) {
+        throw std::invalid_argument("document id "s + std::to_string(document_id) + " is invalid or already exists"s);
+    }
+    pending_->AddDocument(document_id, document, status, ratings);
+    document_ids_.insert(document_id);
+    
+    if (pending_->GetDocumentCount() >= segment_size_) {
+        PublishPending();
+    }
+}
+
+void SegmentedSearchServer::Publish() {
+    std::lock_guard guard(writer_mutex_);
+    PublishPending();
+}
+
+size_t SegmentedSearchServer::GetDocumentCount() const {
+    return segments_.Read()->document_count;
+}
+
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus sought_status, size_t top_count) const {
+    return FindTopDocuments(std::execution::seq, raw_query, sought_status, top_count);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> SegmentedSearchServer::MatchDocument(std::string_view raw_query, int document_id) const {
+    const SearchServer::Query query = parser_.ParseQuery(raw_query);
+    const auto segments = segments_.Read();
+    for (const auto& server : segments->servers) {
+        if (!server->HasDocument(document_id)) {
+            continue;
+        }
+        auto [words, status] = server->MatchDocument(raw_query, document_id);
+        //Слова переносятся в строки запроса, которые переживут сегмент. Найденное слово - начало слова запроса:
+        //для экранированного cat** сервер находит cat*, и первое слово запроса с этим началом стоит на lower_bound
+        for (std::string_view& word : words) {
+            word = std::lower_bound(query.plus_words.begin(), query.plus_words.end(), word)->substr(0, word.size());
+        }
+        return {words, status};
+    }
+    throw std::out_of_range("document id "s + std::to_string(document_id) + " is not published"s);
+}
+
+void SegmentedSearchServer::PublishPending() {
+    if (pending_->GetDocumentCount() == 0) {
+        return;
+    }
+    
+    //снимок подменяет только писатель, поэтому копия набора сегментов не устареет до Publish
+    auto segments = std::make_unique<Segments>();
+    {
+        const auto current = segments_.Read();
+        *segments = *current;
+    }
+    segments->document_count += pending_->GetDocumentCount();
+    
+    std::shared_ptr<const SearchServer> segment = std::move(pending_);
+    pending_ = std::make_unique<SearchServer>(parser_.GetStopWords());
+    while (!segments->servers.empty() && segments->servers.back()->GetDocumentCount() <= segment->GetDocumentCount()) {
+        auto merged = std::make_shared<SearchServer>(parser_.GetStopWords());
+        merged->Merge(*segments->servers.back());
+        merged->Merge(*segment);
+        segments->servers.pop_back();
+        segment = std::move(merged);
+    }
+    segments->servers.push_back(std::move(segment));
+    
+    segments_.Publish(std::move(segments));
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "document.h"
+#include "rcu_pointer.h"
+#include "search_server.h"
+
+#include <algorithm>
+#include <cmath>
+#include <execution>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+const size_t DEFAULT_SEGMENT_SIZE = 4096;
+
+//Индекс, который пополняется, не останавливая поиск. Новые документы копятся в буфере писателя и публикуются
+//неизменяемым сегментом - отдельным SearchServer. Набор сегментов подменяется через RcuPointer, так что запрос
+//без блокировок видит согласованный снимок, а idf считается по всему снимку сразу.
+//Чтобы сегментов оставалось O(log n), новый сегмент сливается с предыдущим, пока тот не крупнее его
+class SegmentedSearchServer {
+public:
+    template <typename StopWords>
+    explicit SegmentedSearchServer(const StopWords& stop_words, size_t segment_size = DEFAULT_SEGMENT_SIZE)
+        : parser_(stop_words),
+          segment_size_(segment_size),
+          segments_(std::make_unique<const Segments>()),
+          pending_(std::make_unique<SearchServer>(parser_.GetStopWords())) {}
+    
+    //писатели сериализуются между собой; документ виден поиску после Publish или когда буфер наберёт segment_size документов
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    void Publish();
+    
+    //число опубликованных документов
+    size_t GetDocumentCount() const;
+    
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate predicate,
+                                           size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate predicate,
+                                           size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus sought_status = DocumentStatus::ACTUAL,
+                                           size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus sought_status = DocumentStatus::ACTUAL,
+                                           size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    
+    //найденные слова ссылаются на текст запроса: сегмент с документом может быть слит с другим сразу после вызова
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
+
+private:
+    struct Segments {
+        std::vector<std::shared_ptr<const SearchServer>> servers; //от старых к новым
+        size_t document_count = 0;
+    };
+    
+    void PublishPending();
+    
+    const SearchServer parser_; //пустой сервер со стоп-словами: разбирает запросы и служит образцом для новых сегментов
+    const size_t segment_size_;
+    RcuPointer<Segments> segments_;
+    
+    std::mutex writer_mutex_;
+    std::unique_ptr<SearchServer> pending_;
+    std::set<int> document_ids_; //все id, включая ещё не опубликованные
+};
+
+template <typename DocumentPredicate>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate predicate, size_t top_count) const {
+    return FindTopDocuments(std::execution::seq, raw_query, predicate, top_count);
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate predicate,
+                                                              size_t top_count) const {
+    SearchServer::Query query = parser_.ParseQuery(raw_query);
+    const auto segments = segments_.Read();
+    
+    //Префиксы раскрываются до общих границ, а idf считается по всему снимку, чтобы релевантность документа
+    //не зависела от того, в какой сегмент он попал
+    if (!SearchServer::GetPrefixWords(query).empty()) {
+        std::vector<std::vector<std::vector<std::string>>> expansions;
+        for (const auto& server : segments->servers) {
+            expansions.push_back(server->GetPrefixExpansions(query));
+        }
+        SearchServer::BoundPrefixExpansions(query, expansions);
+    }
+    for (const std::string_view word : query.plus_words) {
+        size_t document_freq = 0;
+        for (const auto& server : segments->servers) {
+            document_freq += server->GetDocumentFrequency(word, query.FindPrefixLastWord(word));
+        }
+        query.plus_word_idfs.push_back(document_freq ? std::log(segments->document_count * 1.0 / document_freq) : 0.0);
+    }
+    
+    std::vector<std::vector<Document>> segment_documents(segments->servers.size());
+    std::transform(policy, segments->servers.begin(), segments->servers.end(), segment_documents.begin(), [&](const auto& server) {
+        return server->FindQueryTopDocuments(policy, query, predicate, top_count);
+    });
+    
+    std::vector<Document> documents;
+    for (const std::vector<Document>& part : segment_documents) {
+        documents.insert(documents.end(), part.begin(), part.end());
+    }
+    const size_t count = std::min(top_count, documents.size());
+    std::partial_sort(documents.begin(), documents.begin() + count, documents.end(), SearchServer::IsMoreRelevant);
+    documents.resize(count);
+    return documents;
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus sought_status,
+                                                              size_t top_count) const {
+    return FindTopDocuments(policy, raw_query, SearchServer::StatusPredicate{sought_status}, top_count);
+}
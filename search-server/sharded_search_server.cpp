@@ -0,0 +1,29 @@
+#include "sharded_search_server.h"
+
+#include <stdexcept>
+
+using namespace std::string_literals;
+
+void ShardedSearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    //повтор id отвергнет сам шард: документы с одним id всегда попадают в один шард
+    if (document_id < 0) {
+        throw std::invalid_argument("document id "s + std::to_string(document_id) + " is invalid or already exists"s);
+    }
+    shards_[document_id % shards_.size()]->AddDocument(document_id, document, status, ratings);
+}
+
+size_t ShardedSearchServer::GetDocumentCount() const {
+    size_t document_count = 0;
+    for (const auto& shard : shards_) {
+        document_count += shard->GetDocumentCount();
+    }
+    return document_count;
+}
+
+size_t ShardedSearchServer::GetShardCount() const {
+    return shards_.size();
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus sought_status, size_t top_count) const {
+    return FindTopDocuments(std::execution::seq, raw_query, sought_status, top_count);
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "document.h"
+#include "search_server.h"
+#include "search_shard.h"
+
+#include <algorithm>
+#include <cmath>
+#include <execution>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//Индекс, разбитый на шарды по остатку id документа от деления на их число. Запрос разбирается здесь, рассылается
+//всем шардам, а их лучшие документы сливаются в общую выдачу. idf считается по частотам слов во всех шардах,
+//поэтому выдача совпадает с выдачей одного SearchServer со всеми документами
+class ShardedSearchServer {
+public:
+    //шарды в этом процессе
+    template <typename StopWords>
+    ShardedSearchServer(const StopWords& stop_words, size_t shard_count);
+    //готовые шарды, например SocketSearchShard; их стоп-слова должны совпадать с stop_words
+    template <typename StopWords>
+    ShardedSearchServer(const StopWords& stop_words, std::vector<std::unique_ptr<SearchShard>> shards);
+    
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    size_t GetDocumentCount() const;
+    size_t GetShardCount() const;
+    
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus sought_status = DocumentStatus::ACTUAL,
+                                           size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    //политика задаёт, опрашиваются ли шарды параллельно
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus sought_status = DocumentStatus::ACTUAL,
+                                           size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
+
+private:
+    const SearchServer parser_; //пустой сервер со стоп-словами, только разбирает запросы
+    std::vector<std::unique_ptr<SearchShard>> shards_;
+};
+
+template <typename StopWords>
+ShardedSearchServer::ShardedSearchServer(const StopWords& stop_words, size_t shard_count) : parser_(stop_words) {
+    using namespace std::string_literals;
+    if (shard_count == 0) {
+        throw std::invalid_argument("shard count must be positive"s);
+    }
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.push_back(std::make_unique<LocalSearchShard>(parser_.GetStopWords()));
+    }
+}
+
+template <typename StopWords>
+ShardedSearchServer::ShardedSearchServer(const StopWords& stop_words, std::vector<std::unique_ptr<SearchShard>> shards)
+    : parser_(stop_words), shards_(std::move(shards)) {
+    using namespace std::string_literals;
+    if (shards_.empty()) {
+        throw std::invalid_argument("shard count must be positive"s);
+    }
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus sought_status,
+                                                            size_t top_count) const {
+    SearchServer::Query query = parser_.ParseQuery(raw_query);
+    
+    //Нулевая фаза, если в запросе есть префиксы: первые слова каждого префикса в каждом шарде. Без общих границ каждый
+    //шард раскрыл бы префикс до своих первых MAX_PREFIX_EXPANSION_COUNT слов, и выдача зависела бы от разбиения
+    if (!SearchServer::GetPrefixWords(query).empty()) {
+        std::vector<std::vector<std::vector<std::string>>> expansions(shards_.size());
+        std::transform(policy, shards_.begin(), shards_.end(), expansions.begin(), [&query](const auto& shard) {
+            return shard->GetPrefixExpansions(query);
+        });
+        SearchServer::BoundPrefixExpansions(query, expansions);
+    }
+    
+    //первая фаза: число документов и частоты плюс-слов в каждом шарде
+    struct ShardStatistics {
+        size_t document_count;
+        std::vector<size_t> document_freqs;
+    };
+    std::vector<ShardStatistics> statistics(shards_.size());
+    std::transform(policy, shards_.begin(), shards_.end(), statistics.begin(), [&query](const auto& shard) {
+        return ShardStatistics{shard->GetDocumentCount(), shard->GetDocumentFrequencies(query)};
+    });
+    const size_t document_count = std::accumulate(statistics.begin(), statistics.end(), size_t{0}, [](size_t sum, const ShardStatistics& shard) {
+        return sum + shard.document_count;
+    });
+    for (size_t i = 0; i < query.plus_words.size(); ++i) {
+        size_t document_freq = 0;
+        for (const ShardStatistics& shard : statistics) {
+            document_freq += shard.document_freqs[i];
+        }
+        query.plus_word_idfs.push_back(document_freq ? std::log(document_count * 1.0 / document_freq) : 0.0);
+    }
+    
+    //вторая фаза: лучшие документы каждого шарда по общим idf
+    std::vector<std::vector<Document>> shard_documents(shards_.size());
+    std::transform(policy, shards_.begin(), shards_.end(), shard_documents.begin(), [&](const auto& shard) {
+        return shard->FindTopDocuments(query, sought_status, top_count);
+    });
+    
+    std::vector<Document> documents;
+    for (const std::vector<Document>& part : shard_documents) {
+        documents.insert(documents.end(), part.begin(), part.end());
+    }
+    const size_t count = std::min(top_count, documents.size());
+    std::partial_sort(documents.begin(), documents.begin() + count, documents.end(), SearchServer::IsMoreRelevant);
+    documents.resize(count);
+    return documents;
+}
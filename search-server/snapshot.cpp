@@ -0,0 +1,167 @@
+#include "snapshot.h"
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std::string_literals;
+
+namespace {
+
+const char SNAPSHOT_MAGIC[8] = {'S', 'R', 'C', 'H', 'S', 'N', 'A', 'P'};
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+const uint64_t FNV_PRIME = 1099511628211ull;
+const size_t SECTION_ALIGNMENT = 8;
+
+//все секции дополнены до 8 байт, поэтому сумма считается словами, а не байтами
+uint64_t UpdateChecksum(uint64_t checksum, const char* data, size_t size) {
+    for (size_t i = 0; i < size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        checksum = (checksum ^ word) * FNV_PRIME;
+    }
+    return checksum;
+}
+
+size_t AlignUp(size_t size) {
+    return (size + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+}
+
+} // namespace
+
+SnapshotWriter::SnapshotWriter(const std::string& path)
+    : path_(path), out_(path + ".tmp"s, std::ios::out | std::ios::binary | std::ios::trunc), checksum_(FNV_OFFSET_BASIS) {
+    if (!out_) {
+        throw std::runtime_error("cannot open snapshot "s + path + ".tmp for writing"s);
+    }
+    //место под заголовок, он дописывается в Finish
+    const SnapshotHeader header{};
+    out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+void SnapshotWriter::Write(const void* data, size_t size) {
+    //секция пишется кусками, чтобы дополнение нулями попадало в контрольную сумму вместе с данными
+    const size_t aligned_size = AlignUp(size);
+    const size_t whole = size / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+    out_.write(static_cast<const char*>(data), whole);
+    checksum_ = UpdateChecksum(checksum_, static_cast<const char*>(data), whole);
+    
+    if (aligned_size != whole) {
+        char tail[SECTION_ALIGNMENT] = {};
+        std::memcpy(tail, static_cast<const char*>(data) + whole, size - whole);
+        out_.write(tail, sizeof(tail));
+        checksum_ = UpdateChecksum(checksum_, tail, sizeof(tail));
+    }
+    payload_size_ += aligned_size;
+}
+
+void SnapshotWriter::WriteStrings(const std::vector<std::string_view>& strings) {
+    std::vector<uint64_t> offsets;
+    offsets.reserve(strings.size() + 1);
+    std::string chars;
+    for (const std::string_view str : strings) {
+        offsets.push_back(chars.size());
+        chars += str;
+    }
+    offsets.push_back(chars.size());
+    
+    WriteArray(offsets);
+    Write(chars.data(), chars.size());
+}
+
+void SnapshotWriter::Finish(SnapshotHeader header) {
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.checksum = checksum_;
+    header.payload_size = payload_size_;
+    
+    out_.seekp(0);
+    out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out_.close();
+    //Готовый файл подменяет старый переименованием: сервер, загруженный из старого снимка, читает его на месте,
+    //и перезапись поверх отображения оборвала бы его чтение
+    if (!out_ || std::rename((path_ + ".tmp"s).c_str(), path_.c_str()) != 0) {
+        throw std::runtime_error("failed to write snapshot "s + path_);
+    }
+}
+
+SnapshotReader::SnapshotReader(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("cannot open snapshot "s + path);
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || static_cast<size_t>(file_stat.st_size) < sizeof(SnapshotHeader)) {
+        close(fd);
+        throw std::invalid_argument("snapshot "s + path + " is truncated"s);
+    }
+    size_ = file_stat.st_size;
+    void* mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("cannot map snapshot "s + path);
+    }
+    mapping_ = std::make_shared<const SnapshotMapping>(static_cast<const char*>(mapping), size_);
+    data_ = mapping_->GetData();
+    
+    const SnapshotHeader& header = GetHeader();
+    std::string error;
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0) {
+        error = " is not a search server snapshot"s;
+    } else if (header.version != SNAPSHOT_VERSION) {
+        error = " has unsupported version "s + std::to_string(header.version);
+    } else if (header.payload_size != size_ - sizeof(SnapshotHeader) || header.payload_size % SECTION_ALIGNMENT != 0) {
+        error = " is truncated"s;
+    } else if (UpdateChecksum(FNV_OFFSET_BASIS, data_ + sizeof(SnapshotHeader), header.payload_size) != header.checksum) {
+        error = " is corrupted: checksum mismatch"s;
+    }
+    if (!error.empty()) {
+        throw std::invalid_argument("snapshot "s + path + error);
+    }
+}
+
+SnapshotMapping::~SnapshotMapping() {
+    munmap(const_cast<char*>(data_), size_);
+}
+
+//размер проверяется до умножения и выравнивания, чтобы огромный счётчик не превратился после переполнения в маленький
+const char* SnapshotReader::ReadElements(size_t count, size_t element_size) {
+    if (count > (size_ - pos_) / element_size) {
+        throw std::invalid_argument("snapshot section is out of bounds"s);
+    }
+    return Read(count * element_size);
+}
+
+const char* SnapshotReader::Read(size_t size) {
+    if (size > size_ - pos_) {
+        throw std::invalid_argument("snapshot section is out of bounds"s);
+    }
+    //остаток файла кратен SECTION_ALIGNMENT, так что и выровненная секция в него помещается
+    const size_t aligned_size = AlignUp(size);
+    const char* section = data_ + pos_;
+    pos_ += aligned_size;
+    return section;
+}
+
+std::vector<std::string_view> SnapshotReader::ReadStrings(size_t count) {
+    if (count >= (size_ - pos_) / sizeof(uint64_t)) {
+        throw std::invalid_argument("snapshot section is out of bounds"s);
+    }
+    const uint64_t* offsets = ReadArray<uint64_t>(count + 1);
+    const char* chars = Read(offsets[count]);
+    
+    std::vector<std::string_view> strings;
+    strings.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        if (offsets[i] > offsets[i + 1]) {
+            throw std::invalid_argument("snapshot string table is malformed"s);
+        }
+        strings.emplace_back(chars + offsets[i], offsets[i + 1] - offsets[i]);
+    }
+    return strings;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//Бинарный снимок индекса: заголовок и следом секции, каждая выровнена по 8 байт.
+//Массивы лежат в файле в том же виде, что и в памяти (порядок байт - родной для машины),
+//поэтому файл отображается в память целиком и читается на месте, без разбора.
+//Контрольная сумма (FNV-1a) считается по всему, что идёт после заголовка
+
+const uint32_t SNAPSHOT_VERSION = 2;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t checksum;
+    uint64_t payload_size;
+    uint64_t stop_word_count;
+    uint64_t term_count;
+    uint64_t posting_count;
+    uint64_t document_count;
+};
+
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const std::string& path);
+    
+    template <typename T>
+    void WriteArray(const std::vector<T>& values) {
+        Write(values.data(), values.size() * sizeof(T));
+    }
+    //таблица строк: count + 1 смещений и затем все символы подряд
+    void WriteStrings(const std::vector<std::string_view>& strings);
+    
+    //дописывает заголовок с размером и контрольной суммой секций
+    void Finish(SnapshotHeader header);
+
+private:
+    void Write(const void* data, size_t size);
+    
+    std::string path_; //пишется во временный path_.tmp
+    std::ofstream out_;
+    uint64_t checksum_;
+    uint64_t payload_size_ = 0;
+};
+
+//отображённый в память файл снимка; отображение снимается, когда отпускается последний shared_ptr на него
+class SnapshotMapping {
+public:
+    SnapshotMapping(const char* data, size_t size) : data_(data), size_(size) {}
+    ~SnapshotMapping();
+    
+    SnapshotMapping(const SnapshotMapping&) = delete;
+    SnapshotMapping& operator=(const SnapshotMapping&) = delete;
+    
+    const char* GetData() const { return data_; }
+    size_t GetSize() const { return size_; }
+
+private:
+    const char* data_;
+    size_t size_;
+};
+
+class SnapshotReader {
+public:
+    explicit SnapshotReader(const std::string& path);
+    
+    const SnapshotHeader& GetHeader() const { return *reinterpret_cast<const SnapshotHeader*>(data_); }
+    //тот, кто продолжает читать из файла после SnapshotReader, держит отображение сам
+    const std::shared_ptr<const SnapshotMapping>& GetMapping() const { return mapping_; }
+    
+    //секции читаются по порядку; указатели смотрят прямо в отображённый файл и живут, пока живо отображение.
+    //Счётчики берутся из файла, поэтому слишком большой отвергается исключением до того, как что-то будет прочитано
+    template <typename T>
+    const T* ReadArray(size_t count) {
+        return reinterpret_cast<const T*>(ReadElements(count, sizeof(T)));
+    }
+    std::vector<std::string_view> ReadStrings(size_t count);
+
+private:
+    const char* ReadElements(size_t count, size_t element_size);
+    const char* Read(size_t size);
+    
+    std::shared_ptr<const SnapshotMapping> mapping_;
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    size_t pos_ = sizeof(SnapshotHeader);
+};
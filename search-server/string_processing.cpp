@@ -1,35 +1,161 @@
 #include "string_processing.h"
 
-std::vector<std::string> SplitIntoWords(const std::string& text) {
-    std::vector<std::string> words;
-    std::string word;
-    for (const char c : text) {
-        if (c == ' ' || c == '\t') {
-            if (!word.empty()) {
-                words.push_back(word);
-                word.clear();
-            }
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SEARCH_SERVER_X86_KERNELS
+#endif
+
+namespace {
+
+//разделители слов для обеих версий разбиения
+bool IsSeparator(char c) {
+    return c == ' ' || c == '\t';
+}
+
+//маски разделителей для блока из 64 байт: бит i установлен, если data[i] - разделитель
+using SeparatorMaskKernel = uint64_t (*)(const char* data);
+
+uint64_t SeparatorMaskScalar(const char* data) {
+    uint64_t mask = 0;
+    for (int i = 0; i < 64; ++i) {
+        mask |= static_cast<uint64_t>(IsSeparator(data[i])) << i;
+    }
+    return mask;
+}
+
+#ifdef SEARCH_SERVER_X86_KERNELS
+__attribute__((target("sse2")))
+uint64_t SeparatorMaskSse2(const char* data) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    uint64_t mask = 0;
+    for (int i = 0; i < 4; ++i) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * 16));
+        const __m128i is_separator = _mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, tab));
+        mask |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(is_separator))) << (i * 16);
+    }
+    return mask;
+}
+
+__attribute__((target("avx2")))
+uint64_t SeparatorMaskAvx2(const char* data) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    uint64_t mask = 0;
+    for (int i = 0; i < 2; ++i) {
+        const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i * 32));
+        const __m256i is_separator = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, space), _mm256_cmpeq_epi8(chunk, tab));
+        mask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(is_separator))) << (i * 32);
+    }
+    return mask;
+}
+#endif
+
+//вне x86 собрано только скалярное ядро
+SeparatorMaskKernel GetKernel(TokenizerKernel kernel) {
+    switch (kernel) {
+#ifdef SEARCH_SERVER_X86_KERNELS
+    case TokenizerKernel::SSE2:
+        return SeparatorMaskSse2;
+    case TokenizerKernel::AVX2:
+        return SeparatorMaskAvx2;
+#endif
+    default:
+        return SeparatorMaskScalar;
+    }
+}
+
+//самое широкое ядро, которое поддерживает процессор; выбирается один раз при первом вызове
+SeparatorMaskKernel GetWidestKernel() {
+    static const SeparatorMaskKernel separator_mask = GetKernel(GetSupportedTokenizerKernels().back());
+    return separator_mask;
+}
+
+//вызывает on_word для каждого слова text по порядку. Начала и концы слов ищутся сразу в блоке из 64 байт:
+//начало слова - не разделитель после разделителя, конец - разделитель после не разделителя
+template <typename OnWord>
+void ForEachWord(std::string_view text, SeparatorMaskKernel separator_mask, OnWord on_word) {
+    uint64_t prev_is_separator = 1; //перед началом текста как будто стоит разделитель
+    size_t word_begin = 0;
+    for (size_t offset = 0; offset < text.size(); offset += 64) {
+        uint64_t mask;
+        if (text.size() - offset >= 64) {
+            mask = separator_mask(text.data() + offset);
         } else {
-            word += c;
+            char tail[64];
+            std::memset(tail, ' ', sizeof(tail));
+            std::memcpy(tail, text.data() + offset, text.size() - offset);
+            mask = separator_mask(tail);
         }
-    }
-    if (!word.empty()) {
-        words.push_back(word);
+        
+        const uint64_t shifted = (mask << 1) | prev_is_separator;
+        const uint64_t begins = ~mask & shifted;
+        uint64_t boundaries = begins | (mask & ~shifted);
+        while (boundaries) {
+            const size_t pos = offset + __builtin_ctzll(boundaries);
+            if (begins & (boundaries & -boundaries)) {
+                word_begin = pos;
+            } else {
+                on_word(text.substr(word_begin, pos - word_begin));
+            }
+            boundaries &= boundaries - 1;
+        }
+        prev_is_separator = mask >> 63;
     }
     
+    //хвост дополнен пробелами, поэтому слово у самого конца текста закрывается внутри цикла,
+    //кроме случая, когда длина текста кратна 64
+    if (!text.empty() && text.size() % 64 == 0 && !prev_is_separator) {
+        on_word(text.substr(word_begin));
+    }
+}
+
+} // namespace
+
+std::vector<std::string> SplitIntoWords(const std::string& text) {
+    std::vector<std::string> words;
+    ForEachWord(text, GetWidestKernel(), [&](std::string_view word) {
+        words.emplace_back(word);
+    });
     return words;
 }
 
 std::vector<std::string_view> SplitIntoWordsView(std::string_view str) {
     std::vector<std::string_view> result;
-    for (size_t caret; (caret = str.find_first_not_of(' ')) != str.npos; ) {
-        str.remove_prefix(min(str.size(), caret));
-        
-        caret = str.find(' ');
-        result.push_back(str.substr(0, min(str.size(), caret)));
-        
-        str.remove_prefix(min(str.size(), caret));
+    ForEachWord(str, GetWidestKernel(), [&](std::string_view word) {
+        result.push_back(word);
+    });
+    return result;
+}
+
+std::pmr::vector<std::string_view> SplitIntoWordsView(std::string_view str, std::pmr::memory_resource* resource) {
+    std::pmr::vector<std::string_view> result(resource);
+    ForEachWord(str, GetWidestKernel(), [&](std::string_view word) {
+        result.push_back(word);
+    });
+    return result;
+}
+
+std::vector<TokenizerKernel> GetSupportedTokenizerKernels() {
+    std::vector<TokenizerKernel> kernels = {TokenizerKernel::SCALAR};
+#ifdef SEARCH_SERVER_X86_KERNELS
+    if (__builtin_cpu_supports("sse2")) {
+        kernels.push_back(TokenizerKernel::SSE2);
     }
-    
+    if (__builtin_cpu_supports("avx2")) {
+        kernels.push_back(TokenizerKernel::AVX2);
+    }
+#endif
+    return kernels;
+}
+
+std::vector<std::string_view> SplitIntoWordsView(std::string_view str, TokenizerKernel kernel) {
+    std::vector<std::string_view> result;
+    ForEachWord(str, GetKernel(kernel), [&](std::string_view word) {
+        result.push_back(word);
+    });
     return result;
 }
@@ -1,7 +1,36 @@
 #pragma once
 
+#include <cstdint>
+#include <functional>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <vector>
 
 std::vector<std::string> SplitIntoWords(const std::string& text);
 std::vector<std::string_view> SplitIntoWordsView(std::string_view str);
+std::pmr::vector<std::string_view> SplitIntoWordsView(std::string_view str, std::pmr::memory_resource* resource);
+
+//ядро поиска разделителей; разбиение само берёт самое широкое из тех, что поддерживает процессор
+enum class TokenizerKernel {
+    SCALAR,
+    SSE2,
+    AVX2,
+};
+
+//поддерживаемые процессором ядра, от самого узкого к самому широкому; SCALAR есть всегда
+std::vector<TokenizerKernel> GetSupportedTokenizerKernels();
+//разбиение заданным ядром, чтобы сверять ядра между собой; ядро должно быть из GetSupportedTokenizerKernels
+std::vector<std::string_view> SplitIntoWordsView(std::string_view str, TokenizerKernel kernel);
+
+//хэш множества слов: слова подаются по возрастанию и без повторов, поэтому он не зависит ни от порядка слов в тексте, ни от повторов
+class WordSetHasher {
+public:
+    void Add(std::string_view word) {
+        hash_ = (hash_ ^ std::hash<std::string_view>{}(word)) * 1099511628211ull;
+    }
+    uint64_t Get() const { return hash_; }
+
+private:
+    uint64_t hash_ = 14695981039346656037ull;
+};
@@ -0,0 +1,77 @@
+#include "term_dictionary.h"
+
+#include <algorithm>
+
+namespace {
+
+//число по 7 бит в байте, старший бит - признак продолжения
+void WriteVarint(size_t value, std::vector<char>& data) {
+    while (value >= 0x80) {
+        data.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    data.push_back(static_cast<char>(value));
+}
+
+size_t ReadVarint(const std::vector<char>& data, size_t& offset) {
+    size_t value = 0;
+    for (unsigned shift = 0; ; shift += 7) {
+        const unsigned char byte = data[offset++];
+        value |= static_cast<size_t>(byte & 0x7F) << shift;
+        if (byte < 0x80) {
+            return value;
+        }
+    }
+}
+
+} // namespace
+
+size_t TermDictionary::GetMemoryUsage() const {
+    return data_.capacity() * sizeof(char) + block_offsets_.capacity() * sizeof(uint32_t);
+}
+
+void TermDictionary::Add(std::string_view previous_word, std::string_view word, size_t term_id) {
+    size_t shared_size = 0;
+    if (size_ % TERM_DICTIONARY_BLOCK_SIZE == 0) {
+        block_offsets_.push_back(static_cast<uint32_t>(data_.size()));
+    } else {
+        shared_size = std::mismatch(previous_word.begin(), previous_word.end(), word.begin(), word.end()).first - previous_word.begin();
+    }
+    WriteVarint(shared_size, data_);
+    WriteVarint(word.size() - shared_size, data_);
+    data_.insert(data_.end(), word.begin() + shared_size, word.end());
+    WriteVarint(term_id, data_);
+    ++size_;
+}
+
+std::string_view TermDictionary::GetBlockFirstWord(size_t block_index) const {
+    size_t offset = block_offsets_[block_index];
+    ReadVarint(data_, offset); //у первого слова блока общего префикса нет
+    const size_t size = ReadVarint(data_, offset);
+    return {data_.data() + offset, size};
+}
+
+size_t TermDictionary::FindPrefixOffset(std::string_view prefix) const {
+    //первый блок, который начинается со слова не меньше prefix; искомое слово может быть и в конце предыдущего
+    size_t left = 0;
+    size_t right = block_offsets_.size();
+    while (left < right) {
+        const size_t middle = left + (right - left) / 2;
+        if (GetBlockFirstWord(middle) < prefix) {
+            left = middle + 1;
+        } else {
+            right = middle;
+        }
+    }
+    return left == 0 ? 0 : block_offsets_[left - 1];
+}
+
+size_t TermDictionary::DecodeEntry(size_t offset, std::string& word, size_t& term_id) const {
+    const size_t shared_size = ReadVarint(data_, offset);
+    const size_t suffix_size = ReadVarint(data_, offset);
+    word.resize(shared_size);
+    word.append(data_.data() + offset, suffix_size);
+    offset += suffix_size;
+    term_id = ReadVarint(data_, offset);
+    return offset;
+}
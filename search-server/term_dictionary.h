@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+const size_t TERM_DICTIONARY_BLOCK_SIZE = 16;
+
+//Неизменяемый отсортированный словарь слов индекса с фронтальным кодированием. Слова идут блоками по TERM_DICTIONARY_BLOCK_SIZE:
+//первое слово блока хранится целиком, остальные - длиной общего с предыдущим словом префикса и остатком, за словом - его term id.
+//Все записи лежат подряд в одном массиве байт, а поиск двоичный по первым словам блоков, поэтому перебор слов с общим префиксом
+//читает память последовательно, а не обходит узлы дерева
+class TermDictionary {
+public:
+    //words - пары (слово, term id), отсортированные по слову без повторов
+    template <typename WordContainer>
+    explicit TermDictionary(const WordContainer& words) {
+        std::string_view previous_word;
+        for (const auto& [word, term_id] : words) {
+            Add(previous_word, word, term_id);
+            previous_word = word;
+        }
+    }
+    
+    size_t size() const { return size_; }
+    //байты, занятые словарём, без учёта самого объекта
+    size_t GetMemoryUsage() const;
+    
+    //Вызывает function(word, term_id) для слов, начинающихся с prefix, в порядке возрастания слов,
+    //пока function возвращает true; word действителен только во время вызова
+    template <typename Function>
+    void ForEachWithPrefix(std::string_view prefix, Function function) const {
+        std::string word;
+        size_t term_id = 0;
+        for (size_t offset = FindPrefixOffset(prefix); offset < data_.size(); ) {
+            offset = DecodeEntry(offset, word, term_id);
+            if (std::string_view(word) < prefix) {
+                continue;
+            }
+            if (word.compare(0, prefix.size(), prefix) != 0 || !function(std::string_view(word), term_id)) {
+                return;
+            }
+        }
+    }
+
+private:
+    void Add(std::string_view previous_word, std::string_view word, size_t term_id);
+    std::string_view GetBlockFirstWord(size_t block_index) const;
+    //начало блока, в котором может оказаться первое слово не меньше prefix
+    size_t FindPrefixOffset(std::string_view prefix) const;
+    //дописывает к общему префиксу в word остаток записи по смещению offset; возвращает смещение следующей записи
+    size_t DecodeEntry(size_t offset, std::string& word, size_t& term_id) const;
+    
+    std::vector<char> data_; //записи: длина общего префикса, длина остатка, остаток, term id; числа - varint
+    std::vector<uint32_t> block_offsets_;
+    size_t size_ = 0;
+};
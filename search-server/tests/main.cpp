@@ -0,0 +1,919 @@
+//проверки написаны на assert, поэтому программа собирается без NDEBUG при любых флагах
+#undef NDEBUG
+
+#include "../async_search.h"
+#include "../request_queue.h"
+#include "../search_server.h"
+#include "../search_shard.h"
+#include "../segmented_search_server.h"
+#include "../sharded_search_server.h"
+#include "../string_processing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <execution>
+#include <filesystem>
+#include <future>
+#include <limits>
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std::string_literals;
+
+//Случайный корпус из небольшого словаря: слова часто повторяются и в документах, и в запросах,
+//а документы разной длины, так что частоты слов получаются разными
+struct TestCorpus {
+    std::vector<std::string> documents;
+    std::vector<std::vector<int>> ratings;
+    std::vector<std::string> queries;
+};
+
+TestCorpus GenerateTestCorpus(size_t document_count, size_t query_count, size_t words_per_query, uint32_t seed,
+                              size_t dictionary_size = 60) {
+
+    std::mt19937 generator(seed);
+    std::vector<std::string> dictionary;
+    for (size_t i = 0; i < dictionary_size; ++i) {
+        std::string word;
+        const int length = 2 + generator() % 5;
+        for (int j = 0; j < length; ++j) {
+            word += static_cast<char>('a' + generator() % 6);
+        }
+        dictionary.push_back(word);
+    }
+    auto random_word = [&]() -> const std::string& {
+        return dictionary[generator() % dictionary_size];
+    };
+
+    TestCorpus corpus;
+    for (size_t i = 0; i < document_count; ++i) {
+        std::string document;
+        const size_t word_count = 1 + generator() % 40;
+        for (size_t j = 0; j < word_count; ++j) {
+            document += random_word() + ' ';
+        }
+        corpus.documents.push_back(document);
+        corpus.ratings.push_back({static_cast<int>(generator() % 10), static_cast<int>(generator() % 10)});
+    }
+    for (size_t i = 0; i < query_count; ++i) {
+        std::string query;
+        for (size_t j = 0; j < words_per_query; ++j) {
+            query += random_word() + ' ';
+        }
+        query += '-' + random_word();
+        corpus.queries.push_back(query);
+    }
+    return corpus;
+}
+
+//те же запросы, в которых плюс-слова обрезаны до префиксов из prefix_size букв
+std::vector<std::string> MakePrefixQueries(const std::vector<std::string>& queries, size_t prefix_size) {
+    std::vector<std::string> prefix_queries;
+    for (const std::string& query : queries) {
+        std::string prefix_query;
+        for (const std::string_view word : SplitIntoWordsView(query)) {
+            prefix_query += word[0] == '-' ? word : word.substr(0, prefix_size);
+            prefix_query += word[0] == '-' ? " "s : "* "s;
+        }
+        prefix_queries.push_back(prefix_query);
+    }
+    return prefix_queries;
+}
+
+//сокет для шарда index этого процесса
+std::string MakeTestSocketPath(size_t index) {
+    return (std::filesystem::temp_directory_path()
+            / ("search_server_test_"s + std::to_string(getpid()) + "_"s + std::to_string(index) + ".sock"s)).string();
+}
+
+//документы совпадают до бита: релевантность сравнивается точно, без EPSILON
+bool IsSameDocuments(const std::vector<Document>& lhs, const std::vector<Document>& rhs) {
+    return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](const Document& lhs, const Document& rhs) {
+        return lhs.id == rhs.id && lhs.relevance == rhs.relevance && lhs.rating == rhs.rating;
+    });
+}
+
+//параллельный поиск выдаёт те же документы с той же до бита релевантностью, что и последовательный
+void TestParallelSearchMatchesSequential() {
+    const size_t DOCUMENT_COUNT = 5000;
+    const TestCorpus corpus = GenerateTestCorpus(DOCUMENT_COUNT, 50, 30, 1);
+    SearchServer search_server("and in at"s);
+    for (size_t i = 0; i < DOCUMENT_COUNT; ++i) {
+        search_server.AddDocument(static_cast<int>(i * 3), corpus.documents[i], static_cast<DocumentStatus>(i % 2), corpus.ratings[i]);
+    }
+
+    auto is_even_rating = [](int, DocumentStatus, int rating) {
+        return rating % 2 == 0;
+    };
+    for (const std::string& query : corpus.queries) {
+        for (const size_t top_count : {size_t{5}, DOCUMENT_COUNT}) {
+            assert(IsSameDocuments(search_server.FindTopDocuments(std::execution::seq, query, DocumentStatus::ACTUAL, top_count),
+                                   search_server.FindTopDocuments(std::execution::par, query, DocumentStatus::ACTUAL, top_count)));
+            assert(IsSameDocuments(search_server.FindTopDocuments(std::execution::seq, query, is_even_rating, top_count),
+                                   search_server.FindTopDocuments(std::execution::par, query, is_even_rating, top_count)));
+        }
+    }
+}
+
+//Индекс в том виде, в каком он был до интернирования слов: словарь словарей частот. По нему релевантность
+//считается в том же порядке слов, что и у сервера, так что и суммы должны совпасть до бита
+class ReferenceIndex {
+public:
+    explicit ReferenceIndex(const std::set<std::string>& stop_words) : stop_words_(stop_words) {}
+
+    void AddDocument(int document_id, const std::string& document, DocumentStatus status) {
+        std::vector<std::string> words;
+        for (const std::string& word : SplitIntoWords(document)) {
+            if (stop_words_.count(word) == 0) {
+                words.push_back(word);
+            }
+        }
+        const double inv_word_count = 1.0 / words.size();
+        for (const std::string& word : words) {
+            word_to_document_freqs_[word][document_id] += inv_word_count;
+            document_to_word_freqs_[document_id][word] += inv_word_count;
+        }
+        statuses_[document_id] = status;
+    }
+
+    void RemoveDocument(int document_id) {
+        for (const auto& [word, _] : document_to_word_freqs_[document_id]) {
+            word_to_document_freqs_[word].erase(document_id);
+            if (word_to_document_freqs_[word].empty()) {
+                word_to_document_freqs_.erase(word);
+            }
+        }
+        document_to_word_freqs_.erase(document_id);
+        statuses_.erase(document_id);
+    }
+
+    //id документа -> релевантность для запроса из слов без префиксов
+    std::map<int, double> FindAllDocuments(const std::string& raw_query, DocumentStatus status) const {
+        std::set<std::string> plus_words;
+        std::set<std::string> minus_words;
+        for (const std::string& word : SplitIntoWords(raw_query)) {
+            if (word[0] == '-') {
+                minus_words.insert(word.substr(1));
+            } else if (stop_words_.count(word) == 0) {
+                plus_words.insert(word);
+            }
+        }
+
+        std::map<int, double> document_to_relevance;
+        for (const std::string& word : plus_words) {
+            const auto it = word_to_document_freqs_.find(word);
+            if (it == word_to_document_freqs_.end()) {
+                continue;
+            }
+            const double inverse_document_freq = std::log(statuses_.size() * 1.0 / it->second.size());
+            for (const auto& [document_id, term_freq] : it->second) {
+                if (statuses_.at(document_id) == status && !HasAnyWord(document_id, minus_words)) {
+                    document_to_relevance[document_id] += term_freq * inverse_document_freq;
+                }
+            }
+        }
+        return document_to_relevance;
+    }
+
+    std::vector<std::string> MatchDocument(const std::string& raw_query, int document_id) const {
+        std::set<std::string> plus_words;
+        std::set<std::string> minus_words;
+        for (const std::string& word : SplitIntoWords(raw_query)) {
+            if (word[0] == '-') {
+                minus_words.insert(word.substr(1));
+            } else if (stop_words_.count(word) == 0) {
+                plus_words.insert(word);
+            }
+        }
+        if (HasAnyWord(document_id, minus_words)) {
+            return {};
+        }
+        std::vector<std::string> matched_words;
+        for (const std::string& word : plus_words) {
+            if (HasAnyWord(document_id, {word})) {
+                matched_words.push_back(word);
+            }
+        }
+        return matched_words;
+    }
+
+    const std::map<std::string, double>& GetWordFrequencies(int document_id) const {
+        return document_to_word_freqs_.at(document_id);
+    }
+
+private:
+    bool HasAnyWord(int document_id, const std::set<std::string>& words) const {
+        const auto& word_freqs = document_to_word_freqs_.at(document_id);
+        return std::any_of(words.begin(), words.end(), [&](const std::string& word) {
+            return word_freqs.count(word) != 0;
+        });
+    }
+
+    const std::set<std::string> stop_words_;
+    std::map<std::string, std::map<int, double>> word_to_document_freqs_;
+    std::map<int, std::map<std::string, double>> document_to_word_freqs_;
+    std::map<int, DocumentStatus> statuses_;
+};
+
+//Постинги, прямой индекс и список документов сервера согласованы с эталонным индексом: и когда id приходят
+//не по порядку и вставляются в середину списков, и после удаления документов
+void TestIndexMatchesReference() {
+    const size_t DOCUMENT_COUNT = 2000;
+    const TestCorpus corpus = GenerateTestCorpus(DOCUMENT_COUNT, 50, 5, 2);
+    std::vector<int> document_ids(DOCUMENT_COUNT);
+    for (size_t i = 0; i < DOCUMENT_COUNT; ++i) {
+        document_ids[i] = static_cast<int>(i * 7);
+    }
+    std::shuffle(document_ids.begin(), document_ids.end(), std::mt19937(2));
+
+    SearchServer search_server("and in at"s);
+    ReferenceIndex reference({"and"s, "in"s, "at"s});
+    for (size_t i = 0; i < DOCUMENT_COUNT; ++i) {
+        const DocumentStatus status = static_cast<DocumentStatus>(i % 3);
+        search_server.AddDocument(document_ids[i], corpus.documents[i], status, corpus.ratings[i]);
+        reference.AddDocument(document_ids[i], corpus.documents[i], status);
+    }
+
+    auto check = [&](const std::set<int>& live_ids) {
+        assert(search_server.GetDocumentCount() == live_ids.size());
+        assert(std::equal(search_server.begin(), search_server.end(), live_ids.begin(), live_ids.end()));
+        for (const int document_id : live_ids) {
+            const auto& word_freqs = search_server.GetWordFrequencies(document_id);
+            const auto& expected_word_freqs = reference.GetWordFrequencies(document_id);
+            assert(std::equal(word_freqs.begin(), word_freqs.end(), expected_word_freqs.begin(), expected_word_freqs.end(),
+                              [](const auto& lhs, const auto& rhs) {
+                return lhs.first == rhs.first && lhs.second == rhs.second;
+            }));
+        }
+        for (const std::string& query : corpus.queries) {
+            for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT, DocumentStatus::BANNED}) {
+                const std::map<int, double> expected = reference.FindAllDocuments(query, status);
+                for (const auto& documents : {search_server.FindTopDocuments(std::execution::seq, query, status, DOCUMENT_COUNT),
+                                              search_server.FindTopDocuments(std::execution::par, query, status, DOCUMENT_COUNT)}) {
+                    std::map<int, double> actual;
+                    for (const Document& document : documents) {
+                        actual[document.id] = document.relevance;
+                    }
+                    assert(actual == expected);
+                }
+            }
+            for (const int document_id : {*live_ids.begin(), *live_ids.rbegin()}) {
+                const auto [words, status] = search_server.MatchDocument(query, document_id);
+                const std::vector<std::string> expected_words = reference.MatchDocument(query, document_id);
+                assert(std::equal(words.begin(), words.end(), expected_words.begin(), expected_words.end()));
+            }
+        }
+    };
+
+    std::set<int> live_ids(document_ids.begin(), document_ids.end());
+    check(live_ids);
+    //удаляется каждый третий документ, попеременно последовательной и параллельной версией
+    for (size_t i = 0; i < DOCUMENT_COUNT; i += 3) {
+        if (i % 2 == 0) {
+            search_server.RemoveDocument(std::execution::seq, document_ids[i]);
+        } else {
+            search_server.RemoveDocument(std::execution::par, document_ids[i]);
+        }
+        reference.RemoveDocument(document_ids[i]);
+        live_ids.erase(document_ids[i]);
+    }
+    check(live_ids);
+}
+
+//Разбиение посимвольным циклом, каким оно было до поблочного поиска разделителей
+std::vector<std::string_view> SplitIntoWordsByChars(std::string_view text) {
+    std::vector<std::string_view> words;
+    size_t word_begin = 0;
+    for (size_t i = 0; i <= text.size(); ++i) {
+        if (i == text.size() || text[i] == ' ' || text[i] == '\t') {
+            if (i > word_begin) {
+                words.push_back(text.substr(word_begin, i - word_begin));
+            }
+            word_begin = i + 1;
+        }
+    }
+    return words;
+}
+
+//Все поддерживаемые ядра разбивают текст так же, как посимвольный цикл: и когда разделитель или конец слова
+//приходится на границы 64-байтных блоков, и на случайных строках, где есть и другие пробельные и не-ASCII байты
+void TestTokenizerKernelsAgree() {
+    std::vector<std::string> texts;
+    for (const size_t length : {63, 64, 65, 127, 128, 129, 191, 192, 193}) {
+        for (const size_t separator_pos : {0, 1, 62, 63, 64, 65, 66, 126, 127, 128, 129}) {
+            for (const char separator : {' ', '\t'}) {
+                if (separator_pos >= length) {
+                    continue;
+                }
+                std::string text(length, 'w');
+                text[separator_pos] = separator;
+                texts.push_back(text);
+                //разделители на каждой границе блока сразу
+                for (size_t pos = 63; pos < length; pos += 64) {
+                    text[pos] = separator;
+                    if (pos + 1 < length) {
+                        text[pos + 1] = separator;
+                    }
+                }
+                texts.push_back(text);
+            }
+        }
+    }
+    std::mt19937 generator(7);
+    const std::string ALPHABET = "ab \t\n\r\v\xa0\xff"s;
+    for (size_t i = 0; i < 2000; ++i) {
+        std::string text(generator() % 300, ' ');
+        for (char& c : text) {
+            c = ALPHABET[generator() % ALPHABET.size()];
+        }
+        texts.push_back(text);
+    }
+
+    //слова сравниваются по положению в тексте, а не только по содержимому
+    auto is_same_words = [](const std::vector<std::string_view>& lhs, const std::vector<std::string_view>& rhs) {
+        return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](std::string_view lhs, std::string_view rhs) {
+            return lhs.data() == rhs.data() && lhs.size() == rhs.size();
+        });
+    };
+    const std::vector<TokenizerKernel> kernels = GetSupportedTokenizerKernels();
+    assert(kernels.front() == TokenizerKernel::SCALAR);
+    for (const std::string& text : texts) {
+        const std::vector<std::string_view> expected = SplitIntoWordsByChars(text);
+        for (const TokenizerKernel kernel : kernels) {
+            assert(is_same_words(SplitIntoWordsView(text, kernel), expected));
+        }
+        assert(is_same_words(SplitIntoWordsView(text), expected));
+        const std::vector<std::string> words = SplitIntoWords(text);
+        assert(std::equal(words.begin(), words.end(), expected.begin(), expected.end()));
+    }
+}
+
+//Сервер, загруженный из снимка, читает постинги и прямой индекс прямо из файла, пока его не изменят. И до изменений,
+//и после он отвечает так же, как сервер, из которого снимок сохранён
+void TestSnapshotRoundTrip() {
+    const size_t DOCUMENT_COUNT = 2000;
+    const size_t ADDED_COUNT = 100;
+    const TestCorpus corpus = GenerateTestCorpus(DOCUMENT_COUNT + ADDED_COUNT, 50, 5, 3);
+    SearchServer original("and in at"s);
+    for (size_t i = 0; i < DOCUMENT_COUNT; ++i) {
+        original.AddDocument(static_cast<int>(i * 2), corpus.documents[i], static_cast<DocumentStatus>(i % 3), corpus.ratings[i]);
+    }
+
+    const std::string path = (std::filesystem::temp_directory_path() / "search_server_test.snapshot").string();
+    original.SaveSnapshot(path);
+    SnapshotReader reader(path);
+    SearchServer loaded(reader);
+    assert(loaded.GetPostingsMemoryUsage() < original.GetPostingsMemoryUsage());
+
+    auto check = [&](const SearchServer& search_server) {
+        assert(std::equal(search_server.begin(), search_server.end(), original.begin(), original.end()));
+        for (const int document_id : original) {
+            const auto& word_freqs = search_server.GetWordFrequencies(document_id);
+            const auto& expected_word_freqs = original.GetWordFrequencies(document_id);
+            assert(std::equal(word_freqs.begin(), word_freqs.end(), expected_word_freqs.begin(), expected_word_freqs.end()));
+        }
+        for (const std::string& query : corpus.queries) {
+            for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT, DocumentStatus::BANNED}) {
+                assert(IsSameDocuments(search_server.FindTopDocuments(std::execution::seq, query, status, 10),
+                                       original.FindTopDocuments(std::execution::seq, query, status, 10)));
+                assert(IsSameDocuments(search_server.FindTopDocuments(std::execution::par, query, status, DOCUMENT_COUNT),
+                                       original.FindTopDocuments(std::execution::par, query, status, DOCUMENT_COUNT)));
+            }
+            for (const int document_id : {*original.begin(), *std::prev(original.end())}) {
+                assert(search_server.MatchDocument(query, document_id) == original.MatchDocument(query, document_id));
+            }
+        }
+    };
+
+    check(loaded);
+    //изменённые списки копируются к себе, а остальные по-прежнему читаются из файла;
+    //документ 0 удаляется и добавляется заново с другим текстом
+    for (size_t i = 0; i < DOCUMENT_COUNT; i += 5) {
+        for (SearchServer* search_server : {&original, &loaded}) {
+            if (i % 2 == 0) {
+                search_server->RemoveDocument(std::execution::seq, static_cast<int>(i * 2));
+            } else {
+                search_server->RemoveDocument(std::execution::par, static_cast<int>(i * 2));
+            }
+        }
+    }
+    for (size_t i = DOCUMENT_COUNT; i < DOCUMENT_COUNT + ADDED_COUNT; ++i) {
+        const int document_id = i == DOCUMENT_COUNT ? 0 : static_cast<int>(i * 2);
+        for (SearchServer* search_server : {&original, &loaded}) {
+            search_server->AddDocument(document_id, corpus.documents[i], DocumentStatus::ACTUAL, corpus.ratings[i]);
+        }
+    }
+    check(loaded);
+    //дубликат документа из снимка находится по его словам в прямом индексе файла
+    for (SearchServer* search_server : {&original, &loaded}) {
+        search_server->SetSkipDuplicates(true);
+        search_server->AddDocument(static_cast<int>(DOCUMENT_COUNT * 10), corpus.documents[1], DocumentStatus::ACTUAL, {1});
+    }
+    check(loaded);
+    //новый снимок пишется поверх файла, из которого сервер ещё читает
+    loaded.SaveSnapshot(path);
+    SnapshotReader new_reader(path);
+    const SearchServer reloaded(new_reader);
+    std::remove(path.c_str());
+    check(reloaded);
+    for (SearchServer* search_server : {&original, &loaded}) {
+        search_server->CompressPostings();
+    }
+    check(loaded);
+}
+
+//Частота, которая не получается при индексации (не положительная, NaN или бесконечность), отвергается при загрузке
+void TestSnapshotRejectsInvalidTermFreqs() {
+    const std::string path = (std::filesystem::temp_directory_path() / "search_server_test.snapshot").string();
+    //один документ 5 из одного слова cat
+    auto write_snapshot = [&](double term_freq) {
+        SnapshotWriter writer(path);
+        SnapshotHeader header{};
+        writer.WriteStrings({});
+        header.document_count = 1;
+        writer.WriteArray(std::vector<int32_t>{5});
+        writer.WriteArray(std::vector<int32_t>{0});
+        writer.WriteArray(std::vector<int32_t>{static_cast<int32_t>(DocumentStatus::ACTUAL)});
+        header.term_count = 1;
+        header.posting_count = 1;
+        writer.WriteStrings({"cat"});
+        writer.WriteArray(std::vector<uint64_t>{1});
+        writer.WriteArray(std::vector<int32_t>{5});
+        writer.WriteArray(std::vector<double>{term_freq});
+        writer.WriteArray(std::vector<uint64_t>{0, 1});
+        writer.WriteArray(std::vector<uint32_t>{0});
+        writer.Finish(header);
+    };
+
+    write_snapshot(1.0);
+    {
+        SnapshotReader reader(path);
+        const SearchServer search_server(reader);
+        assert(search_server.FindTopDocuments("cat"s).size() == 1);
+    }
+    for (const double term_freq : {0.0, -1.0, std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::infinity()}) {
+        write_snapshot(term_freq);
+        SnapshotReader reader(path);
+        bool is_rejected = false;
+        try {
+            const SearchServer search_server(reader);
+        } catch (const std::invalid_argument&) {
+            is_rejected = true;
+        }
+        assert(is_rejected);
+    }
+    std::remove(path.c_str());
+}
+
+//Звёздочка в конце слова запроса делает его префиксом, удвоенная ищет слово, которое само кончается звёздочкой,
+//а одиночная звёздочка - обычное слово
+void TestQueryStarWords() {
+    const std::vector<std::string> documents = {"cat"s, "cat*"s, "catalog"s, "* rating"s, "**"s};
+    SearchServer search_server("and"s);
+    SegmentedSearchServer segmented_search_server("and"s, 2);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(static_cast<int>(i + 1), documents[i], DocumentStatus::ACTUAL, {1});
+        segmented_search_server.AddDocument(static_cast<int>(i + 1), documents[i], DocumentStatus::ACTUAL, {1});
+    }
+    segmented_search_server.Publish();
+
+    auto find_ids = [&](const std::string& query) {
+        std::set<int> ids;
+        for (const Document& document : search_server.FindTopDocuments(query)) {
+            ids.insert(document.id);
+        }
+        std::set<int> segmented_ids;
+        for (const Document& document : segmented_search_server.FindTopDocuments(query)) {
+            segmented_ids.insert(document.id);
+        }
+        assert(ids == segmented_ids);
+        return ids;
+    };
+    assert(find_ids("cat"s) == std::set<int>({1}));
+    assert(find_ids("cat*"s) == std::set<int>({1, 2, 3}));
+    assert(find_ids("cat**"s) == std::set<int>({2}));
+    assert(find_ids("cat* -cat**"s) == std::set<int>({1, 3}));
+    assert(find_ids("*"s) == std::set<int>({4}));
+    assert(find_ids("**"s) == std::set<int>({4}));
+    assert(find_ids("***"s) == std::set<int>({5}));
+    assert(find_ids("rating -*"s).empty());
+    assert(search_server.GetDocumentFrequency("cat**"s) == 1);
+    assert(search_server.GetDocumentFrequency("cat*"s) == 3);
+
+    //найденное слово - слово документа, а не запроса
+    auto match_words = [&](const std::string& query, int document_id) {
+        const auto [words, status] = search_server.MatchDocument(query, document_id);
+        const auto [par_words, par_status] = search_server.MatchDocument(std::execution::par, query, document_id);
+        const auto [segmented_words, segmented_status] = segmented_search_server.MatchDocument(query, document_id);
+        assert(words == par_words && words == segmented_words);
+        return std::vector<std::string>(words.begin(), words.end());
+    };
+    assert(match_words("cat** dog"s, 2) == std::vector<std::string>({"cat*"s}));
+    assert(match_words("cat**"s, 1).empty());
+    assert(match_words("cat* cat**"s, 2) == std::vector<std::string>({"cat*"s, "cat*"s}));
+    assert(match_words("*"s, 4) == std::vector<std::string>({"*"s}));
+    assert(match_words("***"s, 5) == std::vector<std::string>({"**"s}));
+
+    for (const std::string& query : {"-"s, "--cat"s, "cat -"s}) {
+        bool is_rejected = false;
+        try {
+            search_server.FindTopDocuments(query);
+        } catch (const std::invalid_argument&) {
+            is_rejected = true;
+        }
+        assert(is_rejected);
+    }
+}
+
+//Со сроком с запасом выдача та же, что у FindTopDocuments, и не помечена неполной. С истёкшим сроком или отменённый
+//запрос отдаёт пустую неполную выдачу. Однобуквенные префиксы - чтобы срок проверялся и при объединении списков
+void TestDeadlineSearch() {
+    using Clock = std::chrono::steady_clock;
+    const size_t DOCUMENT_COUNT = 2000;
+    const auto GENEROUS_DEADLINE = std::chrono::seconds(10);
+    const TestCorpus corpus = GenerateTestCorpus(DOCUMENT_COUNT, 50, 5, 5);
+    SearchServer search_server("and in at"s);
+    for (size_t i = 0; i < DOCUMENT_COUNT; ++i) {
+        search_server.AddDocument(static_cast<int>(i), corpus.documents[i], DocumentStatus::ACTUAL, corpus.ratings[i]);
+    }
+    std::vector<std::string> queries = corpus.queries;
+    for (const std::string& prefix_query : MakePrefixQueries(corpus.queries, 1)) {
+        queries.push_back(prefix_query);
+    }
+
+    CancellationToken cancelled_token;
+    cancelled_token.Cancel();
+    for (const std::string& query : queries) {
+        const std::vector<Document> expected = search_server.FindTopDocuments(query);
+        const SearchResult seq_result = search_server.FindTopDocuments(std::execution::seq, query, DocumentStatus::ACTUAL, MAX_RESULT_DOCUMENT_COUNT,
+                                                                       Clock::now() + GENEROUS_DEADLINE);
+        const SearchResult par_result = search_server.FindTopDocuments(std::execution::par, query, DocumentStatus::ACTUAL, MAX_RESULT_DOCUMENT_COUNT,
+                                                                       Clock::now() + GENEROUS_DEADLINE);
+        assert(!seq_result.is_partial && IsSameDocuments(expected, seq_result.documents));
+        assert(!par_result.is_partial && IsSameDocuments(expected, par_result.documents));
+        for (const SearchResult& result : {search_server.FindTopDocuments(std::execution::seq, query, DocumentStatus::ACTUAL, MAX_RESULT_DOCUMENT_COUNT,
+                                                                          Clock::now() - std::chrono::milliseconds(1)),
+                                           search_server.FindTopDocuments(std::execution::par, query, DocumentStatus::ACTUAL, MAX_RESULT_DOCUMENT_COUNT,
+                                                                          Clock::now() + GENEROUS_DEADLINE, cancelled_token),
+                                           search_server.FindTopDocuments(std::execution::seq, query, DocumentStatus::ACTUAL, MAX_RESULT_DOCUMENT_COUNT,
+                                                                          Clock::now() + GENEROUS_DEADLINE, cancelled_token)}) {
+            assert(result.is_partial && result.documents.empty());
+        }
+    }
+}
+
+//Срок истекает посреди параллельного поиска: обход постингов обрывается, выдача помечена неполной, а в ней только
+//документы полной выдачи с релевантностью не больше полной - часть вкладов слов до них не дошла
+void TestDeadlineExpiresDuringParallelSearch() {
+    const size_t DOCUMENT_COUNT = 3000;
+    const std::string query = "curly cat dog"s;
+    SearchServer search_server("and"s);
+    for (size_t i = 0; i < DOCUMENT_COUNT; ++i) {
+        search_server.AddDocument(static_cast<int>(i), i % 3 == 0 ? "curly cat"s : "dog"s, DocumentStatus::ACTUAL, {static_cast<int>(i % 7)});
+    }
+    std::map<int, double> full_relevances;
+    for (const Document& document : search_server.FindTopDocuments(std::execution::par, query, DocumentStatus::ACTUAL, DOCUMENT_COUNT)) {
+        full_relevances[document.id] = document.relevance;
+    }
+    assert(full_relevances.size() == DOCUMENT_COUNT);
+
+    //каждый постинг проходит через предикат, который спит, так что без срока поиск шёл бы больше секунды
+    std::atomic<size_t> predicate_calls{0};
+    const SearchResult result = search_server.FindTopDocuments(std::execution::par, query, [&predicate_calls](int, DocumentStatus, int) {
+        ++predicate_calls;
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        return true;
+    }, DOCUMENT_COUNT, std::chrono::steady_clock::now() + std::chrono::milliseconds(20));
+    assert(result.is_partial);
+    //постингов у слов запроса: curly и cat в каждом третьем документе, dog в остальных
+    const size_t posting_count = DOCUMENT_COUNT / 3 * 2 + DOCUMENT_COUNT / 3 * 2;
+    assert(predicate_calls < posting_count / 2);
+    assert(result.documents.size() < DOCUMENT_COUNT);
+    for (const Document& document : result.documents) {
+        const auto it = full_relevances.find(document.id);
+        assert(it != full_relevances.end() && document.relevance <= it->second + EPSILON);
+    }
+}
+
+//Выдача AsyncSearcher совпадает с FindTopDocuments. Пока единственный поток пула занят запросом, чей предикат ждёт
+//открытия gate, следующий запрос остаётся в очереди на одно место, а ещё один не помещается. Запрос из очереди
+//отменяется, пока ждёт, а ошибка разбора приходит через future
+void TestAsyncSearcher() {
+    using Clock = std::chrono::steady_clock;
+    const size_t DOCUMENT_COUNT = 2000;
+    const auto GENEROUS_DEADLINE = std::chrono::seconds(10);
+    const TestCorpus corpus = GenerateTestCorpus(DOCUMENT_COUNT, 50, 5, 6);
+    SearchServer search_server("and in at"s);
+    for (size_t i = 0; i < DOCUMENT_COUNT; ++i) {
+        search_server.AddDocument(static_cast<int>(i), corpus.documents[i], DocumentStatus::ACTUAL, corpus.ratings[i]);
+    }
+    {
+        AsyncSearcher searcher(search_server, 2, corpus.queries.size());
+        std::vector<std::future<SearchResult>> results;
+        for (const std::string& query : corpus.queries) {
+            results.push_back(searcher.FindTopDocuments(query, DocumentStatus::ACTUAL, MAX_RESULT_DOCUMENT_COUNT, Clock::now() + GENEROUS_DEADLINE));
+        }
+        for (size_t i = 0; i < corpus.queries.size(); ++i) {
+            const SearchResult result = results[i].get();
+            assert(!result.is_partial && IsSameDocuments(search_server.FindTopDocuments(corpus.queries[i]), result.documents));
+        }
+    }
+
+    const std::string& query = corpus.queries.front();
+    assert(!search_server.FindTopDocuments(query).empty());
+    AsyncSearcher searcher(search_server, 1, 1);
+    std::promise<void> gate;
+    const std::shared_future<void> gate_opened = gate.get_future().share();
+    const auto is_started = std::make_shared<std::atomic<bool>>(false);
+    std::future<SearchResult> blocked_result = searcher.FindTopDocuments(query, [gate_opened, is_started](int, DocumentStatus, int) {
+        *is_started = true;
+        gate_opened.wait();
+        return true;
+    }, MAX_RESULT_DOCUMENT_COUNT, Clock::now() + GENEROUS_DEADLINE);
+    while (!*is_started) {
+        std::this_thread::yield();
+    }
+    CancellationToken token;
+    std::future<SearchResult> cancelled_result = searcher.FindTopDocuments(query, DocumentStatus::ACTUAL, MAX_RESULT_DOCUMENT_COUNT,
+                                                                           Clock::now() + GENEROUS_DEADLINE, token);
+    bool is_rejected = false;
+    try {
+        searcher.FindTopDocuments(query, DocumentStatus::ACTUAL, MAX_RESULT_DOCUMENT_COUNT, Clock::now() + GENEROUS_DEADLINE);
+    } catch (const std::runtime_error&) {
+        is_rejected = true;
+    }
+    token.Cancel();
+    gate.set_value();
+    assert(is_rejected && searcher.GetRejectedCount() == 1);
+    assert(!blocked_result.get().is_partial);
+    const SearchResult cancelled = cancelled_result.get();
+    assert(cancelled.is_partial && cancelled.documents.empty());
+
+    std::future<SearchResult> invalid_result = searcher.FindTopDocuments("--cat"s, DocumentStatus::ACTUAL, MAX_RESULT_DOCUMENT_COUNT,
+                                                                         Clock::now() + GENEROUS_DEADLINE);
+    bool is_invalid = false;
+    try {
+        invalid_result.get();
+    } catch (const std::invalid_argument&) {
+        is_invalid = true;
+    }
+    assert(is_invalid);
+}
+
+//Деструктор AsyncSearcher не бросает принятые запросы: пока поток пула занят, он ждёт, а затем выполняет всю очередь,
+//и к его возврату каждый future готов и несёт полную выдачу
+void TestAsyncSearcherShutdownRunsQueuedRequests() {
+    const size_t QUEUED_COUNT = 8;
+    SearchServer search_server("and"s);
+    search_server.AddDocument(1, "curly cat"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "curly dog"s, DocumentStatus::ACTUAL, {2});
+    const std::vector<Document> expected = search_server.FindTopDocuments("curly"s);
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+
+    auto searcher = std::make_unique<AsyncSearcher>(search_server, 1, QUEUED_COUNT);
+    std::promise<void> gate;
+    const std::shared_future<void> gate_opened = gate.get_future().share();
+    const auto is_started = std::make_shared<std::atomic<bool>>(false);
+    std::vector<std::future<SearchResult>> results;
+    results.push_back(searcher->FindTopDocuments("curly"s, [gate_opened, is_started](int, DocumentStatus, int) {
+        *is_started = true;
+        gate_opened.wait();
+        return true;
+    }, MAX_RESULT_DOCUMENT_COUNT, deadline));
+    while (!*is_started) {
+        std::this_thread::yield();
+    }
+    for (size_t i = 0; i < QUEUED_COUNT; ++i) {
+        results.push_back(searcher->FindTopDocuments("curly"s, DocumentStatus::ACTUAL, MAX_RESULT_DOCUMENT_COUNT, deadline));
+    }
+
+    std::atomic<bool> is_destroyed{false};
+    std::thread destroyer([&]() {
+        searcher.reset();
+        is_destroyed = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    assert(!is_destroyed);
+    gate.set_value();
+    destroyer.join();
+    for (std::future<SearchResult>& result : results) {
+        assert(result.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+        const SearchResult search_result = result.get();
+        assert(!search_result.is_partial && IsSameDocuments(expected, search_result.documents));
+    }
+}
+
+//Запросы из нескольких потоков сразу учитываются все до одного, а перцентили упорядочены и не нулевые:
+//это строгие верхние оценки задержек
+void TestRequestQueueCountsConcurrentRequests() {
+    const size_t THREAD_COUNT = 4;
+    const size_t REQUEST_COUNT = 2000;
+    SearchServer search_server("and"s);
+    search_server.AddDocument(1, "curly cat"s, DocumentStatus::ACTUAL, {1});
+    RequestQueue request_queue(search_server);
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < THREAD_COUNT; ++t) {
+        threads.emplace_back([&]() {
+            for (size_t i = 0; i < REQUEST_COUNT; ++i) {
+                request_queue.AddFindRequest(i % 2 == 0 ? "cat"s : "dog"s);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    const RequestStats stats = request_queue.GetStats();
+    assert(stats.requests == THREAD_COUNT * REQUEST_COUNT);
+    assert(stats.no_result_requests == THREAD_COUNT * REQUEST_COUNT / 2);
+    assert(stats.p50.count() > 0 && stats.p50 <= stats.p95 && stats.p95 <= stats.p99);
+}
+
+//Выдача ShardedSearchServer с 1-4 шардами в процессе и с шардами за сокетами, а также SegmentedSearchServer
+//совпадает с выдачей одного SearchServer по всем статусам и нескольким размерам выдачи. Однобуквенные префиксы
+//раскрываются до MAX_PREFIX_EXPANSION_COUNT слов, и раскрытие не должно зависеть от разбиения индекса
+void TestShardedSearchMatchesSingleServer() {
+    const size_t DOCUMENT_COUNT = 2000;
+    const size_t DICTIONARY_SIZE = 1200; //около 200 слов на букву
+    const std::string STOP_WORDS = "and in at"s;
+    const TestCorpus corpus = GenerateTestCorpus(DOCUMENT_COUNT, 20, 3, 4, DICTIONARY_SIZE);
+    std::vector<std::string> queries = corpus.queries;
+    for (const size_t prefix_size : {1, 3}) {
+        for (const std::string& prefix_query : MakePrefixQueries(corpus.queries, prefix_size)) {
+            queries.push_back(prefix_query);
+        }
+    }
+    queries.push_back("b* -a*"s);
+    queries.push_back("c* d* -e* -f"s);
+    auto status_of = [](size_t i) {
+        return static_cast<DocumentStatus>(i % 4);
+    };
+
+    SearchServer search_server(STOP_WORDS);
+    SegmentedSearchServer segmented_search_server(STOP_WORDS, 300);
+    for (size_t i = 0; i < DOCUMENT_COUNT; ++i) {
+        search_server.AddDocument(static_cast<int>(i), corpus.documents[i], status_of(i), corpus.ratings[i]);
+        segmented_search_server.AddDocument(static_cast<int>(i), corpus.documents[i], status_of(i), corpus.ratings[i]);
+    }
+    segmented_search_server.Publish();
+    //без предела проверка не отличила бы общие границы префиксов от раскрытия в каждой части отдельно
+    const std::string wide_prefix = "a*"s;
+    assert(search_server.GetPrefixExpansions(search_server.ParseQuery(wide_prefix)).front().size() == MAX_PREFIX_EXPANSION_COUNT);
+
+    auto check = [&](auto find_top_documents) {
+        for (const std::string& query : queries) {
+            for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT, DocumentStatus::BANNED, DocumentStatus::REMOVED}) {
+                for (const size_t top_count : {1, 5, 100}) {
+                    assert(IsSameDocuments(search_server.FindTopDocuments(query, status, top_count), find_top_documents(query, status, top_count)));
+                }
+            }
+        }
+    };
+    check([&](const std::string& query, DocumentStatus status, size_t top_count) {
+        return segmented_search_server.FindTopDocuments(std::execution::par, query, status, top_count);
+    });
+    auto check_sharded = [&](ShardedSearchServer& sharded_search_server) {
+        for (size_t i = 0; i < DOCUMENT_COUNT; ++i) {
+            sharded_search_server.AddDocument(static_cast<int>(i), corpus.documents[i], status_of(i), corpus.ratings[i]);
+        }
+        check([&](const std::string& query, DocumentStatus status, size_t top_count) {
+            return sharded_search_server.FindTopDocuments(std::execution::par, query, status, top_count);
+        });
+    };
+    for (const size_t shard_count : {1, 2, 3, 4}) {
+        ShardedSearchServer sharded_search_server(STOP_WORDS, shard_count);
+        check_sharded(sharded_search_server);
+    }
+
+    //шарды за сокетами обслуживают потоки этого процесса; поток завершается, когда закрывается соединение с ним
+    const size_t SOCKET_SHARD_COUNT = 3;
+    std::vector<std::unique_ptr<SearchServer>> shard_servers;
+    std::vector<std::thread> shard_threads;
+    std::vector<std::unique_ptr<SearchShard>> shards;
+    for (size_t i = 0; i < SOCKET_SHARD_COUNT; ++i) {
+        SearchServer& shard_server = *shard_servers.emplace_back(std::make_unique<SearchServer>(STOP_WORDS));
+        const std::string socket_path = MakeTestSocketPath(i);
+        shard_threads.emplace_back([&shard_server, socket_path]() {
+            ServeSearchShard(shard_server, socket_path);
+        });
+        shards.push_back(std::make_unique<SocketSearchShard>(socket_path));
+    }
+    {
+        ShardedSearchServer sharded_search_server(STOP_WORDS, std::move(shards));
+        check_sharded(sharded_search_server);
+    }
+    for (std::thread& thread : shard_threads) {
+        thread.join();
+    }
+}
+
+//Шард отвечает ошибкой на idf не для всех плюс-слов и на число элементов больше, чем уместится в сообщение,
+//а соединение после этого работает. На заявленную длину больше MAX_SHARD_MESSAGE_SIZE шард закрывает соединение
+void TestSocketShardRejectsMalformedMessages() {
+    const std::string socket_path = MakeTestSocketPath(0);
+    SearchServer search_server("and"s);
+    search_server.AddDocument(1, "curly cat"s, DocumentStatus::ACTUAL, {1});
+    std::exception_ptr serve_error;
+    auto serve = [&]() {
+        try {
+            ServeSearchShard(search_server, socket_path);
+        } catch (...) {
+            serve_error = std::current_exception();
+        }
+    };
+
+    std::thread shard_thread(serve);
+    {
+        SocketSearchShard shard(socket_path);
+        SearchServer::Query query;
+        query.plus_words = {"curly", "cat"};
+        query.plus_word_idfs = {1.0};
+        bool is_rejected = false;
+        try {
+            shard.FindTopDocuments(query, DocumentStatus::ACTUAL, 5);
+        } catch (const std::invalid_argument&) {
+            is_rejected = true;
+        }
+        assert(is_rejected);
+        query.plus_word_idfs.push_back(1.0);
+        assert(shard.FindTopDocuments(query, DocumentStatus::ACTUAL, 5).size() == 1);
+    }
+    shard_thread.join();
+    assert(!serve_error);
+
+    //дальше сообщения пишутся вручную: клиент шарда неверных не отправляет
+    shard_thread = std::thread(serve);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, socket_path.c_str());
+    const int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+    assert(connection >= 0);
+    while (connect(connection, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(SHARD_CONNECT_RETRY_MS));
+    }
+    auto append = [](std::string& message, auto value) {
+        message.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+    auto send_all = [connection](const std::string& data) {
+        assert(send(connection, data.data(), data.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(data.size()));
+    };
+    //ADD_DOCUMENT с триллионом рейтингов, которых в сообщении нет
+    std::string body;
+    append(body, uint8_t{0});
+    append(body, int32_t{2});
+    append(body, DocumentStatus::ACTUAL);
+    append(body, uint64_t{1} << 40);
+    std::string message;
+    append(message, uint64_t{body.size()});
+    send_all(message + body);
+    uint64_t reply_size = 0;
+    assert(recv(connection, &reply_size, sizeof(reply_size), MSG_WAITALL) == sizeof(reply_size));
+    std::string reply(reply_size, '\0');
+    assert(recv(connection, reply.data(), reply.size(), MSG_WAITALL) == static_cast<ssize_t>(reply.size()));
+    assert(reply[0] != 0 && reply.substr(1) == "truncated shard message"s);
+
+    message.clear();
+    append(message, uint64_t{MAX_SHARD_MESSAGE_SIZE + 1});
+    send_all(message);
+    char byte;
+    assert(recv(connection, &byte, 1, 0) == 0);
+    close(connection);
+    shard_thread.join();
+    assert(serve_error);
+    assert(search_server.GetDocumentCount() == 1);
+}
+
+int main() {
+    TestParallelSearchMatchesSequential();
+    TestIndexMatchesReference();
+    TestTokenizerKernelsAgree();
+    TestSnapshotRoundTrip();
+    TestSnapshotRejectsInvalidTermFreqs();
+    TestQueryStarWords();
+    TestDeadlineSearch();
+    TestDeadlineExpiresDuringParallelSearch();
+    TestAsyncSearcher();
+    TestAsyncSearcherShutdownRunsQueuedRequests();
+    TestRequestQueueCountsConcurrentRequests();
+    TestShardedSearchMatchesSingleServer();
+    TestSocketShardRejectsMalformedMessages();
+    return 0;
+}